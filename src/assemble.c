@@ -0,0 +1,1233 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Assembly of the total matricies (E, D, and K) from their scaled
+// components on a fixed union nonzero pattern
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "config.h"
+#include "assemble.h"
+#include "log.h"
+
+// Number of target entries combined at a time. The tile stays in cache while every component
+// streams through it, so the target is read and written once per assembly.
+#define ASSEMBLY_TILE 1024
+
+// Delta updates accumulate rounding from adding and subtracting the same components, so a
+// full assembly is forced after this many of them
+#define MAX_DELTA_UPDATES 32
+
+// Largest block size tried by the detection (3D vector fields with a few components per node)
+#define MAX_BLOCK_SIZE 8
+
+typedef struct
+{
+  Mat A;                  // SeqAIJ block
+  PetscInt m;             // local rows
+  const PetscInt *ia, *ja;
+  const PetscInt *garray; // global column of each compressed column (off-diagonal only)
+  PetscBool blocks;       // rows and columns count bs x bs blocks (padded storage)
+} LocalBlock;
+
+static void getLocalBlock(Mat M, bool offdiag, LocalBlock *b)
+{
+  Mat Ad, Ao;
+  const PetscInt *garray;
+  PetscBool done;
+
+  MatMPIAIJGetSeqAIJ(M,&Ad,&Ao,&garray);
+  b->A = offdiag ? Ao : Ad;
+  b->garray = offdiag ? garray : NULL;
+  b->blocks = PETSC_FALSE;
+  MatGetRowIJ(b->A,0,PETSC_FALSE,PETSC_FALSE,&(b->m),&(b->ia),&(b->ja),&done);
+  if(!done)
+    logError("#! Could not access the row structure of a local matrix block\n");
+}
+
+static void restoreLocalBlock(LocalBlock *b)
+{
+  PetscBool done;
+  MatRestoreRowIJ(b->A,0,PETSC_FALSE,b->blocks,&(b->m),&(b->ia),&(b->ja),&done);
+}
+
+// Local part of a padded matrix: the diagonal part is SeqSBAIJ or SeqBAIJ, the off-diagonal
+// part SeqBAIJ with block columns compressed by garray (NULL on a single rank, where the
+// matrix is its own diagonal part). MPISBAIJ begins with the MPIBAIJ header, so the same
+// accessor returns its parts.
+static Mat getPaddedPart(Mat M, bool offdiag, const PetscInt **garray)
+{
+  Mat Ad, Ao;
+  const PetscInt *g;
+  PetscBool mpi;
+
+  PetscObjectTypeCompareAny((PetscObject)M,&mpi,MATMPIBAIJ,MATMPISBAIJ,"");
+  if(!mpi) {
+    *garray = NULL;
+    return offdiag ? NULL : M;
+  }
+  MatMPIBAIJGetSeqBAIJ(M,&Ad,&Ao,&g);
+  *garray = offdiag ? g : NULL;
+  return offdiag ? Ao : Ad;
+}
+
+// Block row structure of a local part of a padded matrix, false if there is no such part
+static bool getPaddedBlock(Mat M, bool offdiag, LocalBlock *b)
+{
+  PetscBool done;
+
+  b->A = getPaddedPart(M,offdiag,&(b->garray));
+  if(b->A==NULL)
+    return false;
+  b->blocks = PETSC_TRUE;
+  MatGetRowIJ(b->A,0,PETSC_FALSE,PETSC_TRUE,&(b->m),&(b->ia),&(b->ja),&done);
+  if(!done)
+    logError("#! Could not access the block row structure of a local matrix part\n");
+  return true;
+}
+
+// Values of a local part of a padded matrix, bs x bs (column major) per block
+static PetscScalar *getPaddedValues(Mat P)
+{
+  PetscScalar *v;
+  PetscBool upper;
+
+  PetscObjectTypeCompare((PetscObject)P,MATSEQSBAIJ,&upper);
+  if(upper) MatSeqSBAIJGetArray(P,&v);
+  else      MatSeqBAIJGetArray(P,&v);
+  return v;
+}
+
+static void restorePaddedValues(Mat P, PetscScalar *v)
+{
+  PetscBool upper;
+
+  PetscObjectTypeCompare((PetscObject)P,MATSEQSBAIJ,&upper);
+  if(upper) MatSeqSBAIJRestoreArray(P,&v);
+  else      MatSeqBAIJRestoreArray(P,&v);
+}
+
+static PetscInt *copyRowPointers(const char *matrix_name, const LocalBlock *b)
+{
+  PetscInt *ia = malloc( sizeof(PetscInt)*(b->m+1) );
+  if (ia==NULL)
+    logError("#! Allocation of the row pointers for '%s' failed\n",matrix_name);
+  PetscMemcpy(ia,b->ia,sizeof(PetscInt)*(b->m+1));
+  return ia;
+}
+
+static PetscInt blockColumn(const LocalBlock *b, PetscInt k)
+{
+  return b->garray ? b->garray[b->ja[k]] : b->ja[k];
+}
+
+// Columns are sorted within each row of both blocks (the off-diagonal garray is sorted as well)
+// so each component row is located in the union row with a single merge pass. A component block
+// holding as many nonzeros as the union block has the union pattern and needs no map.
+static PetscInt *mapBlock(const char *matrix_name, const LocalBlock *u, const LocalBlock *c)
+{
+  PetscInt r, k, e, col;
+  PetscInt *map;
+
+  if( c->ia[c->m]==u->ia[u->m] )
+    return NULL;
+  map = malloc( sizeof(PetscInt)*PetscMax(c->ia[c->m],1) );
+  if (map==NULL)
+    logError("#! Allocation of the index map for '%s' failed\n",matrix_name);
+
+  for(r=0;r<c->m;r++)
+  {
+    k=u->ia[r];
+    for(e=c->ia[r];e<c->ia[r+1];e++)
+    {
+      col=blockColumn(c,e);
+      while( k<u->ia[r+1] && blockColumn(u,k)<col ) k++;
+      if( k==u->ia[r+1] || blockColumn(u,k)!=col )
+        logError("#! Component nonzero of '%s' missing from the union pattern\n",matrix_name);
+      map[e]=k;
+    }
+  }
+  return map;
+}
+
+static void setupComponentBlock(const char *matrix_name, const LocalBlock *u, const LocalBlock *c, ComponentBlock *b)
+{
+  b->nnz = c->ia[c->m];
+  b->ia = copyRowPointers(matrix_name,c);
+  b->map = mapBlock(matrix_name,u,c);
+  b->val = NULL;
+  b->re = NULL;
+}
+
+static void freeComponentBlock(ComponentBlock *b)
+{
+  free(b->ia);  b->ia=NULL;
+  free(b->map); b->map=NULL;
+  free(b->re);  b->re=NULL;
+  b->val=NULL;
+}
+
+void getAssemblyOptionsLUA(AssemblyOptions *opts)
+{
+  opts->matrix_free = getOptBooleanLUA("matrix_free",false);
+  opts->stacked = getOptBooleanLUA("stacked_components",false);
+  opts->real = getOptBooleanLUA("real_components",false);
+  opts->blocked = getOptBooleanLUA("block_storage",false);
+  opts->block_size = getOptIntLUA("block_size",0);
+  opts->field_block_size = 1;
+  if(opts->matrix_free && opts->blocked) {
+    logOutput("# block_storage is ignored for matrix-free operators\n");
+    opts->blocked = false;
+  }
+  if(opts->matrix_free && opts->stacked) {
+    logOutput("# stacked_components is ignored for matrix-free operators\n");
+    opts->stacked = false;
+  }
+  if(opts->matrix_free && opts->real) {
+    logOutput("# real_components is ignored for matrix-free operators\n");
+    opts->real = false;
+  }
+}
+
+static bool isRealBlock(const ComponentBlock *b)
+{
+  PetscInt k;
+  for(k=0;k<b->nnz;k++)
+    if(PetscImaginaryPart(b->val[k])!=0)
+      return false;
+  return true;
+}
+
+// The values of the component matricies that are kept (val) are only accessed between these
+// two calls, so no array stays checked out of a Mat between assemblies
+static void getComponentValues(MatrixAssembler *A)
+{
+  int i;
+  Mat Cd, Co;
+  const PetscInt *garray;
+
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(A->Mc->matrix[i]==NULL)
+      continue;
+    MatMPIAIJGetSeqAIJ(A->Mc->matrix[i],&Cd,&Co,&garray);
+    MatSeqAIJGetArray(Cd,&(A->map[i].d.val));
+    MatSeqAIJGetArray(Co,&(A->map[i].o.val));
+  }
+}
+
+static void restoreComponentValues(MatrixAssembler *A)
+{
+  int i;
+  Mat Cd, Co;
+  const PetscInt *garray;
+
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(A->Mc->matrix[i]==NULL)
+      continue;
+    MatMPIAIJGetSeqAIJ(A->Mc->matrix[i],&Cd,&Co,&garray);
+    MatSeqAIJRestoreArray(Cd,&(A->map[i].d.val));
+    MatSeqAIJRestoreArray(Co,&(A->map[i].o.val));
+    A->map[i].d.val = A->map[i].o.val = NULL;
+  }
+}
+
+// Releases the component Mat (its values checked out) once they are no longer referenced
+static void releaseComponent(MatrixAssembler *A, int i)
+{
+  Mat Cd, Co;
+  const PetscInt *garray;
+
+  MatMPIAIJGetSeqAIJ(A->Mc->matrix[i],&Cd,&Co,&garray);
+  MatSeqAIJRestoreArray(Cd,&(A->map[i].d.val));
+  MatSeqAIJRestoreArray(Co,&(A->map[i].o.val));
+  MatDestroy( &(A->Mc->matrix[i]) );
+}
+
+static PetscReal *realValues(const char *matrix_name, const ComponentBlock *b)
+{
+  PetscInt k;
+  PetscReal *re = malloc( sizeof(PetscReal)*PetscMax(b->nnz,1) );
+  if (re==NULL)
+    logError("#! Allocation of the real values of '%s' failed\n",matrix_name);
+  for(k=0;k<b->nnz;k++)
+    re[k] = PetscRealPart(b->val[k]);
+  return re;
+}
+
+// Finds the components whose values are all real. Unless they are about to be stacked, their
+// real parts are copied out and the complex matricies released.
+static void detectRealComponents(MatrixAssembler *A, bool stacked)
+{
+  int i, local, global;
+  double saved, total;
+
+  for(i=0;i<A->Mc->num;i++)
+  {
+    local = isRealBlock(&(A->map[i].d)) && isRealBlock(&(A->map[i].o));
+    MPI_Allreduce(&local,&global,1,MPI_INT,MPI_LAND,PETSC_COMM_WORLD);
+    A->map[i].real = global;
+    if(!A->map[i].real)
+      continue;
+
+    saved = sizeof(PetscReal)*(double)(A->map[i].d.nnz+A->map[i].o.nnz);
+    MPI_Allreduce(&saved,&total,1,MPI_DOUBLE,MPI_SUM,PETSC_COMM_WORLD);
+    logOutput("# component %d of '%s' is real: %.3f MB of values saved\n",i,A->name,total/1048576);
+    if(stacked)
+      continue;
+
+    A->map[i].d.re = realValues(A->name,&(A->map[i].d));
+    A->map[i].o.re = realValues(A->name,&(A->map[i].o));
+    releaseComponent(A,i);
+  }
+}
+
+// Interleaves the values of one block of the components in the complex (real) group into
+// S (R). Entries a component does not have stay zero.
+static void stackBlock(MatrixAssembler *A, PetscInt n, bool offdiag, PetscScalar **S, PetscReal **R)
+{
+  int i;
+  PetscInt k;
+  const ComponentBlock *b;
+
+  *S = malloc( sizeof(PetscScalar)*PetscMax(n*A->nS,1) );
+  *R = malloc( sizeof(PetscReal)*PetscMax(n*A->nR,1) );
+  if (*S==NULL || *R==NULL)
+    logError("#! Allocation of the stacked values of '%s' failed\n",A->name);
+  PetscMemzero(*S,sizeof(PetscScalar)*n*A->nS);
+  PetscMemzero(*R,sizeof(PetscReal)*n*A->nR);
+
+  for(i=0;i<A->Mc->num;i++)
+  {
+    b = offdiag ? &(A->map[i].o) : &(A->map[i].d);
+    for(k=0;k<b->nnz;k++)
+    {
+      if(A->map[i].real)
+        (*R)[(b->map ? b->map[k] : k)*A->nR+A->map[i].slot] = PetscRealPart(b->val[k]);
+      else
+        (*S)[(b->map ? b->map[k] : k)*A->nS+A->map[i].slot] = b->val[k];
+    }
+  }
+}
+
+// Copies all component values into the interleaved arrays and releases the components along
+// with their maps, keeping only the index structure of M
+static void stackComponents(MatrixAssembler *A)
+{
+  int i, num=A->Mc->num;
+  double stats[3], global[3];
+
+  // Index data (column indices and row pointers) and stored entries of the separate components
+  stats[0] = stats[1] = 0;
+  A->nS = A->nR = 0;
+  for(i=0;i<num;i++)
+  {
+    stats[0] += sizeof(PetscInt)*(A->map[i].d.nnz+A->map[i].o.nnz+2*(A->m+1));
+    stats[1] += A->map[i].d.nnz+A->map[i].o.nnz;
+    A->map[i].slot = A->map[i].real ? A->nR++ : A->nS++;
+  }
+  stackBlock(A,A->nd,false,&(A->S_d),&(A->R_d));
+  stackBlock(A,A->no,true,&(A->S_o),&(A->R_o));
+  for(i=0;i<num;i++)
+  {
+    releaseComponent(A,i);
+    freeComponentBlock(&(A->map[i].d));
+    freeComponentBlock(&(A->map[i].o));
+  }
+  A->stacked = true;
+
+  stats[0] -= sizeof(PetscInt)*(A->nd+A->no+2*(A->m+1));
+  stats[1] = (double)num*(A->nd+A->no) - stats[1];
+  stats[2] = (sizeof(PetscScalar)*A->nS+sizeof(PetscReal)*A->nR)*(double)(A->nd+A->no)/num;
+  MPI_Allreduce(stats,global,3,MPI_DOUBLE,MPI_SUM,PETSC_COMM_WORLD);
+  logOutput("# stacked '%s': %.3f MB of component index data deduplicated, %.0f padding zeros added (%.3f MB of stacked values per component)\n",
+            A->name,global[0]/1048576,global[1],global[2]/1048576);
+}
+
+// y = sum_i c_i*M_i*x (or with the transposes)
+static PetscErrorCode shellApply(Mat M, Vec x, Vec y, PetscErrorCode (*mult)(Mat,Vec,Vec))
+{
+  int i;
+  MatrixAssembler *A;
+
+  MatShellGetContext(M,&A);
+  VecSet(y,0);
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(A->coef[i]==0)
+      continue;
+    mult(A->Mc->matrix[i],x,A->work);
+    VecAXPY(y,A->coef[i],A->work);
+  }
+  return 0;
+}
+
+static PetscErrorCode shellMult(Mat M, Vec x, Vec y)
+{
+  return shellApply(M,x,y,MatMult);
+}
+
+static PetscErrorCode shellMultTranspose(Mat M, Vec x, Vec y)
+{
+  return shellApply(M,x,y,MatMultTranspose);
+}
+
+static PetscErrorCode shellGetDiagonal(Mat M, Vec d)
+{
+  int i;
+  MatrixAssembler *A;
+
+  MatShellGetContext(M,&A);
+  VecSet(d,0);
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(A->coef[i]==0)
+      continue;
+    MatGetDiagonal(A->Mc->matrix[i],A->work);
+    VecAXPY(d,A->coef[i],A->work);
+  }
+  return 0;
+}
+
+static void createShell(MatrixAssembler *A)
+{
+  int i;
+  PetscInt m, n, mg, ng, mi, ni;
+
+  MatGetLocalSize(A->Mc->matrix[0],&m,&n);
+  MatGetSize(A->Mc->matrix[0],&mg,&ng);
+  for(i=1;i<A->Mc->num;i++)
+  {
+    MatGetSize(A->Mc->matrix[i],&mi,&ni);
+    if(mi!=mg || ni!=ng)
+      logError("#! Components of '%s' differ in size\n",A->name);
+  }
+  MatCreateShell(PETSC_COMM_WORLD,m,n,mg,ng,A,&(A->M));
+  MatShellSetOperation(A->M,MATOP_MULT,(void(*)(void))shellMult);
+  MatShellSetOperation(A->M,MATOP_MULT_TRANSPOSE,(void(*)(void))shellMultTranspose);
+  MatShellSetOperation(A->M,MATOP_GET_DIAGONAL,(void(*)(void))shellGetDiagonal);
+  MatGetVecs(A->Mc->matrix[0],NULL,&(A->work));
+  logOutput("# '%s' is a matrix-free operator over %d component(s)\n",A->name,A->Mc->num);
+}
+
+static MatrixAssembler *newAssembler(const char *matrix_name, MatrixComponent *Mc)
+{
+  int i;
+  MatrixAssembler *A = malloc( MATRIX_ASSEMBLER_SIZE(Mc->num) );
+  if (A==NULL)
+    logError("#! Allocation of MatrixAssembler for '%s' failed\n",matrix_name);
+  A->name = matrix_name;
+  A->Mc = Mc;
+  A->coef = malloc( sizeof(PetscScalar)*Mc->num );
+  if (A->coef==NULL)
+    logError("#! Allocation of the coefficient cache for '%s' failed\n",matrix_name);
+  A->assembled = false;
+  A->deltas = 0;
+  A->count[ASSEMBLY_SKIPPED] = A->count[ASSEMBLY_DELTA] = A->count[ASSEMBLY_FULL] = 0;
+  for(i=0;i<Mc->num;i++)
+  {
+    A->coef[i] = 0;
+    A->map[i].real = false;
+    A->map[i].slot = i;
+    A->map[i].P = NULL;
+    A->map[i].d.ia = A->map[i].d.map = A->map[i].o.ia = A->map[i].o.map = NULL;
+    A->map[i].d.re = A->map[i].o.re = NULL;
+    A->map[i].d.val = A->map[i].o.val = NULL;
+  }
+
+  A->exponent = 0;
+  A->p_frozen = -1;
+  A->shell = false;
+  A->padded = false;
+  A->bs = 1;
+  A->work = NULL;
+  A->stacked = false;
+  A->nS = A->nR = 0;
+  A->S_d = A->S_o = NULL;
+  A->R_d = A->R_o = NULL;
+  A->ia_d = A->ia_o = NULL;
+  return A;
+}
+
+Mat createSharedPattern(MatrixComponent **Mc, int n)
+{
+  int j, i;
+  Mat pattern;
+
+  MatDuplicate(Mc[0]->matrix[0],MAT_COPY_VALUES,&pattern);
+  for(j=0;j<n;j++)
+    for(i=(j==0 ? 1 : 0);i<Mc[j]->num;i++)
+      MatAXPY(pattern,1,Mc[j]->matrix[i],DIFFERENT_NONZERO_PATTERN);
+  MatZeroEntries(pattern);
+  return pattern;
+}
+
+// Checks that every block row of pattern consists of bs identical rows made of whole, aligned
+// bs x bs blocks (on every rank)
+static bool isBlockPattern(Mat pattern, PetscInt bs)
+{
+  PetscInt M, N, rstart, rend, r, j, nc, nc0=0, *cols0;
+  const PetscInt *cols;
+  int valid=1, valid_all;
+
+  MatGetSize(pattern,&M,&N);
+  MatGetOwnershipRange(pattern,&rstart,&rend);
+  if(M%bs || N%bs || rstart%bs || rend%bs)
+    valid = 0;
+  cols0 = malloc( sizeof(PetscInt)*(N>0 ? N : 1) );
+  if (cols0==NULL)
+    logError("#! Allocation of the block detection buffer failed\n");
+  for(r=rstart;r<rend && valid;r++)
+  {
+    MatGetRow(pattern,r,&nc,&cols,NULL);
+    if((r-rstart)%bs==0) {
+      // First row of a block row, columns must come in complete aligned blocks
+      if(nc%bs) valid = 0;
+      for(j=0;j<nc && valid;j+=bs)
+        if(cols[j]%bs || cols[j+bs-1]!=cols[j]+bs-1) valid = 0;
+      nc0 = nc;
+      PetscMemcpy(cols0,cols,sizeof(PetscInt)*nc);
+    } else {
+      // The other rows of the block row repeat it
+      if(nc!=nc0) valid = 0;
+      for(j=0;j<nc && valid;j++)
+        if(cols[j]!=cols0[j]) valid = 0;
+    }
+    MatRestoreRow(pattern,r,&nc,&cols,NULL);
+  }
+  free(cols0);
+  MPI_Allreduce(&valid,&valid_all,1,MPI_INT,MPI_LAND,PETSC_COMM_WORLD);
+  return valid_all;
+}
+
+PetscInt detectBlockSize(Mat pattern, PetscInt bs)
+{
+  PetscInt b;
+
+  if(bs>1) {
+    if(isBlockPattern(pattern,bs)) {
+      logOutput("# block size %i requested and consistent with all components\n",(int)bs);
+      return bs;
+    }
+    logOutput("# block size %i requested but not consistent with all components\n",(int)bs);
+    return 1;
+  }
+  // The largest consistent size wins, any divisor of it would be consistent too
+  for(b=MAX_BLOCK_SIZE;b>1;b--)
+    if(isBlockPattern(pattern,b)) {
+      logOutput("# block size detection: %i x %i blocks found in all components\n",(int)b,(int)b);
+      return b;
+    }
+  logOutput("# block size detection: no block structure up to %i found\n",MAX_BLOCK_SIZE);
+  return 1;
+}
+
+// Copies W into a new MATBAIJ, or MATSBAIJ holding the upper triangle only, with block size bs,
+// preallocated exactly for the blocks that hold a nonzero of W (the rest of a block is padded
+// with zeros, blocks without any nonzero are not stored)
+static Mat convertPadded(Mat W, bool upper, PetscInt bs)
+{
+  PetscInt m, n, M, N, rstart, rend, cstart, cend, r, j, nc, nb, b, bc;
+  PetscInt *dnnz, *onnz, *seen;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  Mat P;
+
+  MatGetLocalSize(W,&m,&n);
+  MatGetSize(W,&M,&N);
+  MatGetOwnershipRange(W,&rstart,&rend);
+  MatGetOwnershipRangeColumn(W,&cstart,&cend);
+  nb = m/bs;
+  dnnz = calloc( nb>0 ? nb : 1, sizeof(PetscInt) );
+  onnz = calloc( nb>0 ? nb : 1, sizeof(PetscInt) );
+  // Last block row each block column was counted for
+  seen = malloc( (N/bs>0 ? N/bs : 1)*sizeof(PetscInt) );
+  if (dnnz==NULL || onnz==NULL || seen==NULL)
+    logError("#! Allocation of the block preallocation failed\n");
+  for(j=0;j<N/bs;j++)
+    seen[j] = -1;
+  for(b=0;b<nb;b++)
+  {
+    // The rows of a block row may differ, count the union of their block columns
+    for(r=rstart+b*bs;r<rstart+(b+1)*bs;r++)
+    {
+      MatGetRow(W,r,&nc,&cols,NULL);
+      for(j=0;j<nc;j++)
+      {
+        bc = cols[j]/bs;
+        if(seen[bc]==b || (upper && bc<r/bs)) continue;
+        seen[bc] = b;
+        if(cols[j]>=cstart && cols[j]<cend) dnnz[b]++;
+        else                                onnz[b]++;
+      }
+      MatRestoreRow(W,r,&nc,&cols,NULL);
+    }
+  }
+  free(seen);
+
+  MatCreate(PETSC_COMM_WORLD,&P);
+  MatSetSizes(P,m,n,M,N);
+  MatSetType(P,upper ? MATSBAIJ : MATBAIJ);
+  MatSetBlockSize(P,bs);
+  MatXAIJSetPreallocation(P,bs,dnnz,onnz,dnnz,onnz);
+  if(upper)
+    MatSetOption(P,MAT_IGNORE_LOWER_TRIANGULAR,PETSC_TRUE);
+  for(r=rstart;r<rend;r++)
+  {
+    MatGetRow(W,r,&nc,&cols,&vals);
+    MatSetValues(P,1,&r,nc,cols,vals,INSERT_VALUES);
+    MatRestoreRow(W,r,&nc,&cols,&vals);
+  }
+  MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY);
+  free(dnnz);
+  free(onnz);
+  return P;
+}
+
+MatrixAssembler *createPaddedAssembler(const char *matrix_name, MatrixComponent *Mc, Mat pattern,
+                                       bool symmetric, PetscInt bs)
+{
+  int i;
+  MatInfo info;
+  double full=0, stored=0;
+  MatType type = symmetric ? MATSBAIJ : MATBAIJ;
+
+  LocalBlock ud, uo, cd, co;
+  bool offdiag;
+
+  MatrixAssembler *A = newAssembler(matrix_name,Mc);
+  A->padded = true;
+  A->bs = bs;
+  // Only the total matrix has the shared pattern, the components keep their own and are
+  // mapped into it block by block
+  A->M = convertPadded(pattern,symmetric,bs);
+  getPaddedBlock(A->M,false,&ud);
+  offdiag = getPaddedBlock(A->M,true,&uo);
+  A->m = ud.m;
+  A->nd = ud.ia[ud.m];
+  A->no = offdiag ? uo.ia[uo.m] : 0;
+  for(i=0;i<Mc->num;i++)
+  {
+    MatGetInfo(Mc->matrix[i],MAT_GLOBAL_SUM,&info);
+    full += info.nz_used;
+    A->map[i].P = convertPadded(Mc->matrix[i],symmetric,bs);
+    MatGetInfo(A->map[i].P,MAT_GLOBAL_SUM,&info);
+    stored += info.nz_used;
+    MatDestroy( &(Mc->matrix[i]) );
+
+    getPaddedBlock(A->map[i].P,false,&cd);
+    setupComponentBlock(matrix_name,&ud,&cd,&(A->map[i].d));
+    restoreLocalBlock(&cd);
+    if(offdiag) {
+      getPaddedBlock(A->map[i].P,true,&co);
+      setupComponentBlock(matrix_name,&uo,&co,&(A->map[i].o));
+      restoreLocalBlock(&co);
+    }
+  }
+  restoreLocalBlock(&ud);
+  if(offdiag)
+    restoreLocalBlock(&uo);
+
+  logOutput("# %s storage of '%s' (block size %i): %.0f stored component entries instead of %.0f\n",
+            type,matrix_name,(int)bs,stored,full);
+  return A;
+}
+
+// Copies the pattern of W into a new MATMPIAIJ (the type of the components) that is given
+// block size bs before its exact preallocation
+static Mat copyWithBlockSize(Mat W, PetscInt bs)
+{
+  PetscInt m, n, M, N, rstart, rend, cstart, cend, r, j, nc;
+  PetscInt *dnnz, *onnz;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  Mat P;
+
+  MatGetLocalSize(W,&m,&n);
+  MatGetSize(W,&M,&N);
+  MatGetOwnershipRange(W,&rstart,&rend);
+  MatGetOwnershipRangeColumn(W,&cstart,&cend);
+  dnnz = calloc( m>0 ? m : 1, sizeof(PetscInt) );
+  onnz = calloc( m>0 ? m : 1, sizeof(PetscInt) );
+  if (dnnz==NULL || onnz==NULL)
+    logError("#! Allocation of the preallocation counts failed\n");
+  for(r=rstart;r<rend;r++)
+  {
+    MatGetRow(W,r,&nc,&cols,NULL);
+    for(j=0;j<nc;j++)
+    {
+      if(cols[j]>=cstart && cols[j]<cend) dnnz[r-rstart]++;
+      else                                onnz[r-rstart]++;
+    }
+    MatRestoreRow(W,r,&nc,&cols,NULL);
+  }
+
+  MatCreate(PETSC_COMM_WORLD,&P);
+  MatSetSizes(P,m,n,M,N);
+  MatSetType(P,MATMPIAIJ);
+  MatSetBlockSize(P,bs);
+  MatMPIAIJSetPreallocation(P,0,dnnz,0,onnz);
+  for(r=rstart;r<rend;r++)
+  {
+    MatGetRow(W,r,&nc,&cols,&vals);
+    MatSetValues(P,1,&r,nc,cols,vals,INSERT_VALUES);
+    MatRestoreRow(W,r,&nc,&cols,&vals);
+  }
+  MatAssemblyBegin(P,MAT_FINAL_ASSEMBLY);
+  MatAssemblyEnd(P,MAT_FINAL_ASSEMBLY);
+  free(dnnz);
+  free(onnz);
+  return P;
+}
+
+MatrixAssembler *createAssembler(const char *matrix_name, MatrixComponent *Mc, const AssemblyOptions *opts)
+{
+  int i;
+  PetscInt m, n, mi, ni;
+  LocalBlock ud, uo, cd, co;
+  MatInfo info;
+
+  MatrixAssembler *A = newAssembler(matrix_name,Mc);
+  A->shell = opts->matrix_free;
+  if(A->shell) {
+    createShell(A);
+    return A;
+  }
+
+  // Union of all component patterns, merged once here rather than on every assembly
+  MatGetSize(Mc->matrix[0],&m,&n);
+  MatDuplicate(Mc->matrix[0],MAT_COPY_VALUES,&(A->M));
+  for(i=1;i<Mc->num;i++)
+  {
+    MatGetSize(Mc->matrix[i],&mi,&ni);
+    if(mi!=m || ni!=n)
+      logError("#! Components of '%s' differ in size\n",matrix_name);
+    MatAXPY(A->M,1,Mc->matrix[i],DIFFERENT_NONZERO_PATTERN);
+  }
+  MatZeroEntries(A->M);
+  if(opts->field_block_size>1) {
+    Mat W = A->M;
+    A->M = copyWithBlockSize(W,opts->field_block_size);
+    MatDestroy(&W);
+  }
+
+  getLocalBlock(A->M,false,&ud);
+  getLocalBlock(A->M,true,&uo);
+  A->m = ud.m;
+  A->nd = ud.ia[ud.m];
+  A->no = uo.ia[uo.m];
+  A->ia_d = copyRowPointers(matrix_name,&ud);
+  A->ia_o = copyRowPointers(matrix_name,&uo);
+
+  for(i=0;i<Mc->num;i++)
+  {
+    getLocalBlock(Mc->matrix[i],false,&cd);
+    getLocalBlock(Mc->matrix[i],true,&co);
+    setupComponentBlock(matrix_name,&ud,&cd,&(A->map[i].d));
+    setupComponentBlock(matrix_name,&uo,&co,&(A->map[i].o));
+    restoreLocalBlock(&cd);
+    restoreLocalBlock(&co);
+  }
+  restoreLocalBlock(&ud);
+  restoreLocalBlock(&uo);
+
+  MatGetInfo(A->M,MAT_GLOBAL_SUM,&info);
+  logOutput("# union pattern of '%s': %.0f nonzeros over %d component(s)\n",matrix_name,info.nz_used,Mc->num);
+  getComponentValues(A);
+  if(opts->real)
+    detectRealComponents(A,opts->stacked);
+  if(opts->stacked)
+    stackComponents(A);
+  restoreComponentValues(A);
+  return A;
+}
+
+// y += a*x written over the interleaved real/imaginary parts so that the compiler can
+// vectorize it. Real coefficients (the usual case for polynomial scaling functions) reduce
+// to a plain real axpy over 2n values.
+static void streamAXPY(PetscInt n, PetscScalar a, const PetscScalar *x, PetscScalar *y)
+{
+  PetscInt k;
+  const PetscReal ar=PetscRealPart(a), ai=PetscImaginaryPart(a);
+  const PetscReal *restrict xr=(const PetscReal *)x;
+  PetscReal *restrict yr=(PetscReal *)y;
+
+  if(ai==0) {
+    for(k=0;k<2*n;k++)
+      yr[k] += ar*xr[k];
+  } else {
+    for(k=0;k<2*n;k+=2) {
+      yr[k]   += ar*xr[k]   - ai*xr[k+1];
+      yr[k+1] += ar*xr[k+1] + ai*xr[k];
+    }
+  }
+}
+
+// y += a*x for real x, promoted to complex only here
+static void streamAXPYReal(PetscInt n, PetscScalar a, const PetscReal *x, PetscScalar *y)
+{
+  PetscInt k;
+  const PetscReal ar=PetscRealPart(a), ai=PetscImaginaryPart(a);
+  PetscReal *restrict yr=(PetscReal *)y;
+
+  for(k=0;k<n;k++) {
+    yr[2*k]   += ar*x[k];
+    yr[2*k+1] += ai*x[k];
+  }
+}
+
+static void scatterAXPY(PetscInt n, PetscScalar a, const PetscScalar *x, const PetscInt *map, PetscScalar *y)
+{
+  PetscInt k;
+  for(k=0;k<n;k++)
+    y[map[k]] += a*x[k];
+}
+
+static void scatterAXPYReal(PetscInt n, PetscScalar a, const PetscReal *x, const PetscInt *map, PetscScalar *y)
+{
+  PetscInt k;
+  for(k=0;k<n;k++)
+    y[map[k]] += a*x[k];
+}
+
+// v += a*(rows r0 to r1 of the component block b), ui are the row pointers of v
+static void addRows(const ComponentBlock *b, const PetscInt *ui, PetscInt r0, PetscInt r1, PetscScalar a, PetscScalar *v)
+{
+  PetscInt off, n;
+
+  if(b->map==NULL) {
+    off = ui[r0];
+    n = ui[r1]-off;
+    if(b->re) streamAXPYReal(n,a,b->re+off,v+off);
+    else      streamAXPY(n,a,b->val+off,v+off);
+  } else {
+    off = b->ia[r0];
+    n = b->ia[r1]-off;
+    if(b->re) scatterAXPYReal(n,a,b->re+off,b->map+off,v);
+    else      scatterAXPY(n,a,b->val+off,b->map+off,v);
+  }
+}
+
+// v[k] = sum_i cS[i]*S[k*nS+i] + sum_i cR[i]*R[k*nR+i], the components of an entry are
+// adjacent in memory
+static void combineStacked(PetscInt n, int nS, const PetscScalar *cS, const PetscScalar *S,
+                           int nR, const PetscScalar *cR, const PetscReal *R, PetscScalar *v)
+{
+  PetscInt k;
+  int i;
+  PetscScalar sum;
+
+  for(k=0;k<n;k++)
+  {
+    sum = 0;
+    for(i=0;i<nS;i++)
+      sum += cS[i]*S[k*nS+i];
+    for(i=0;i<nR;i++)
+      sum += cR[i]*R[k*nR+i];
+    v[k] = sum;
+  }
+}
+
+// v = sum_i c[i]*M_i over one local block, a tile of rows at a time
+static void combineBlock(MatrixAssembler *A, bool offdiag, const PetscScalar *c, PetscScalar *v)
+{
+  PetscInt r0, r1;
+  const PetscInt *ui = offdiag ? A->ia_o : A->ia_d;
+  int i;
+
+  for(r0=0;r0<A->m;r0=r1)
+  {
+    for(r1=r0+1; r1<A->m && ui[r1+1]-ui[r0]<=ASSEMBLY_TILE; r1++);
+    PetscMemzero(v+ui[r0],sizeof(PetscScalar)*(ui[r1]-ui[r0]));
+    for(i=0;i<A->Mc->num;i++)
+    {
+      if(c[i]==0)
+        continue;
+      addRows(offdiag ? &(A->map[i].o) : &(A->map[i].d),ui,r0,r1,c[i],v);
+    }
+  }
+}
+
+// v (+)= sum_i c[i]*P_i over one local part of padded storage, bs x bs values streamed per
+// mapped block
+static void combinePadded(MatrixAssembler *A, bool offdiag, const PetscScalar *c, bool zero)
+{
+  PetscInt k, bs2=A->bs*A->bs;
+  const PetscInt *garray;
+  const ComponentBlock *b;
+  PetscScalar *v, *x;
+  Mat Mp, Cp;
+  int i;
+
+  Mp = getPaddedPart(A->M,offdiag,&garray);
+  if(Mp==NULL)
+    return;
+  v = getPaddedValues(Mp);
+  if(zero)
+    PetscMemzero(v,sizeof(PetscScalar)*bs2*(offdiag ? A->no : A->nd));
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(c[i]==0)
+      continue;
+    b = offdiag ? &(A->map[i].o) : &(A->map[i].d);
+    Cp = getPaddedPart(A->map[i].P,offdiag,&garray);
+    x = getPaddedValues(Cp);
+    if(b->map==NULL)
+      streamAXPY(bs2*b->nnz,c[i],x,v);
+    else
+      for(k=0;k<b->nnz;k++)
+        streamAXPY(bs2,c[i],x+k*bs2,v+b->map[k]*bs2);
+    restorePaddedValues(Cp,x);
+  }
+  restorePaddedValues(Mp,v);
+}
+
+void combineComponents(MatrixAssembler *A, const PetscScalar *c)
+{
+  int i, num=A->Mc->num;
+  PetscScalar *vd, *vo, cS[num], cR[num];
+  Mat Ad, Ao;
+  const PetscInt *garray;
+
+  if(A->shell) {
+    // Products are formed on the fly, only the coefficients need replacing
+    PetscMemcpy(A->coef,c,sizeof(PetscScalar)*num);
+    PetscObjectStateIncrease((PetscObject)A->M);
+    return;
+  }
+  if(A->padded) {
+    // Every component pattern is contained in the shared pattern of M
+    combinePadded(A,false,c,true);
+    combinePadded(A,true,c,true);
+    PetscObjectStateIncrease((PetscObject)A->M);
+    return;
+  }
+
+  MatMPIAIJGetSeqAIJ(A->M,&Ad,&Ao,&garray);
+  MatSeqAIJGetArray(Ad,&vd);
+  MatSeqAIJGetArray(Ao,&vo);
+  if(A->stacked) {
+    for(i=0;i<num;i++) {
+      if(A->map[i].real) cR[A->map[i].slot] = c[i];
+      else               cS[A->map[i].slot] = c[i];
+    }
+    combineStacked(A->nd,A->nS,cS,A->S_d,A->nR,cR,A->R_d,vd);
+    combineStacked(A->no,A->nS,cS,A->S_o,A->nR,cR,A->R_o,vo);
+  } else {
+    getComponentValues(A);
+    combineBlock(A,false,c,vd);
+    combineBlock(A,true,c,vo);
+    restoreComponentValues(A);
+  }
+  MatSeqAIJRestoreArray(Ad,&vd);
+  MatSeqAIJRestoreArray(Ao,&vo);
+  // Values were changed behind the Mat interface, let PETSc know the operator is new
+  PetscObjectStateIncrease((PetscObject)A->M);
+}
+
+void setAssemblerScaling(MatrixAssembler *A, double exponent, int p_frozen)
+{
+  A->exponent = exponent;
+  A->p_frozen = p_frozen;
+  A->assembled = false;
+}
+
+// Scaling function values for the p-th parameter value times x^exponent
+static void getCoefficients(MatrixAssembler *A, int p, PetscScalar *c)
+{
+  int i;
+  double complex scale=1;
+
+  if(A->p_frozen>=0)
+    p = A->p_frozen;
+  if(A->exponent!=0)
+    scale = cpow(getParameterValue(p),A->exponent);
+  for(i=0;i<A->Mc->num;i++)
+    c[i] = TO_PETSC_COMPLEX( scale*funcParamValue(A->name,p,i) );
+}
+
+// M += a*M_i
+static void addComponent(MatrixAssembler *A, int i, PetscScalar a)
+{
+  PetscInt k;
+  int slot=A->map[i].slot;
+  PetscScalar *vd, *vo, c[A->Mc->num];
+  Mat Ad, Ao;
+  const PetscInt *garray;
+
+  if(A->padded) {
+    PetscMemzero(c,sizeof(c));
+    c[i] = a;
+    combinePadded(A,false,c,false);
+    combinePadded(A,true,c,false);
+    return;
+  }
+  MatMPIAIJGetSeqAIJ(A->M,&Ad,&Ao,&garray);
+  MatSeqAIJGetArray(Ad,&vd);
+  MatSeqAIJGetArray(Ao,&vo);
+  if(A->stacked && A->map[i].real) {
+    for(k=0;k<A->nd;k++) vd[k] += a*A->R_d[k*A->nR+slot];
+    for(k=0;k<A->no;k++) vo[k] += a*A->R_o[k*A->nR+slot];
+  } else if(A->stacked) {
+    for(k=0;k<A->nd;k++) vd[k] += a*A->S_d[k*A->nS+slot];
+    for(k=0;k<A->no;k++) vo[k] += a*A->S_o[k*A->nS+slot];
+  } else {
+    getComponentValues(A);
+    addRows(&(A->map[i].d),A->ia_d,0,A->m,a,vd);
+    addRows(&(A->map[i].o),A->ia_o,0,A->m,a,vo);
+    restoreComponentValues(A);
+  }
+  MatSeqAIJRestoreArray(Ad,&vd);
+  MatSeqAIJRestoreArray(Ao,&vo);
+}
+
+AssemblyStatus updateMatrix(MatrixAssembler *A, int p)
+{
+  int i, changed=0;
+  PetscScalar c[A->Mc->num];
+  AssemblyStatus status;
+
+  getCoefficients(A,p,c);
+  for(i=0;i<A->Mc->num;i++)
+    if( !A->assembled || c[i]!=A->coef[i] )
+      changed++;
+
+  if(changed==0) {
+    status = ASSEMBLY_SKIPPED;
+  } else if(!A->shell && A->assembled && 2*changed<=A->Mc->num && A->deltas<MAX_DELTA_UPDATES) {
+    // Fewer than half of the components changed, a full pass would mostly redo the same sums
+    for(i=0;i<A->Mc->num;i++)
+    {
+      if(c[i]!=A->coef[i]) {
+        addComponent(A,i,c[i]-A->coef[i]);
+        A->coef[i] = c[i];
+      }
+    }
+    A->deltas++;
+    PetscObjectStateIncrease((PetscObject)A->M);
+    status = ASSEMBLY_DELTA;
+  } else {
+    combineComponents(A,c);
+    PetscMemcpy(A->coef,c,sizeof(PetscScalar)*A->Mc->num);
+    A->assembled = true;
+    A->deltas = 0;
+    status = ASSEMBLY_FULL;
+  }
+  A->count[status]++;
+  return status;
+}
+
+int markVaryingRows(MatrixAssembler *A, Vec mark)
+{
+  int i, p, num=A->Mc->num, varying=0;
+  PetscScalar c0[num], c[num], unit[num];
+  bool changes[num];
+  PetscInt rstart, rend, r, k, nc;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  PetscBool upper;
+
+  getCoefficients(A,0,c0);
+  for(i=0;i<num;i++)
+    changes[i] = false;
+  for(p=1;p<getNumberOfParameters();p++)
+  {
+    getCoefficients(A,p,c);
+    for(i=0;i<num;i++)
+      changes[i] = changes[i] || c[i]!=c0[i];
+  }
+
+  PetscObjectTypeCompareAny((PetscObject)A->M,&upper,MATSEQSBAIJ,MATMPISBAIJ,"");
+  MatGetOwnershipRange(A->M,&rstart,&rend);
+  for(i=0;i<num;i++)
+  {
+    if(!changes[i])
+      continue;
+    varying++;
+    // M holds the component alone, whatever its storage
+    PetscMemzero(unit,sizeof(unit));
+    unit[i] = 1;
+    combineComponents(A,unit);
+    if(upper)
+      MatGetRowUpperTriangular(A->M);
+    for(r=rstart;r<rend;r++)
+    {
+      MatGetRow(A->M,r,&nc,&cols,&vals);
+      for(k=0;k<nc;k++)
+      {
+        if(vals[k]==0)
+          continue;
+        VecSetValue(mark,r,1,ADD_VALUES);
+        VecSetValue(mark,cols[k],1,ADD_VALUES);
+      }
+      MatRestoreRow(A->M,r,&nc,&cols,&vals);
+    }
+    if(upper)
+      MatRestoreRowUpperTriangular(A->M);
+  }
+  VecAssemblyBegin(mark);
+  VecAssemblyEnd(mark);
+  A->assembled = false;
+  return varying;
+}
+
+// Local rows where the Mat C has a nonzero (the upper triangle stands for both sides when
+// symmetric)
+static int matrixRows(Mat C)
+{
+  PetscInt rstart, rend, r, k, nc;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  PetscBool upper;
+  int touched=0;
+
+  PetscObjectTypeCompareAny((PetscObject)C,&upper,MATSEQSBAIJ,MATMPISBAIJ,"");
+  if(upper)
+    MatGetRowUpperTriangular(C);
+  MatGetOwnershipRange(C,&rstart,&rend);
+  for(r=rstart;r<rend;r++)
+  {
+    MatGetRow(C,r,&nc,&cols,&vals);
+    for(k=0;k<nc;k++)
+    {
+      if(vals[k]!=0) {
+        touched++;
+        break;
+      }
+    }
+    MatRestoreRow(C,r,&nc,&cols,&vals);
+  }
+  if(upper)
+    MatRestoreRowUpperTriangular(C);
+  return touched;
+}
+
+// True if the stacked values of component i have a nonzero in union entries k0 to k1
+static bool stackedNonzero(const MatrixAssembler *A, int i, bool offdiag, PetscInt k0, PetscInt k1)
+{
+  PetscInt k;
+  int slot=A->map[i].slot;
+  const PetscScalar *S = offdiag ? A->S_o : A->S_d;
+  const PetscReal *R = offdiag ? A->R_o : A->R_d;
+
+  for(k=k0;k<k1;k++)
+    if(A->map[i].real ? R[k*A->nR+slot]!=0 : S[k*A->nS+slot]!=0)
+      return true;
+  return false;
+}
+
+int componentRows(MatrixAssembler *A, int i)
+{
+  PetscInt r;
+  const ComponentBlock *d=&(A->map[i].d), *o=&(A->map[i].o);
+  int touched=0, total;
+
+  if(A->padded) {
+    touched = matrixRows(A->map[i].P);
+  } else if(A->shell) {
+    touched = matrixRows(A->Mc->matrix[i]);
+  } else if(A->stacked) {
+    // Only the union pattern is left, the component is where its stacked values are nonzero
+    for(r=0;r<A->m;r++)
+      if(stackedNonzero(A,i,false,A->ia_d[r],A->ia_d[r+1]) || stackedNonzero(A,i,true,A->ia_o[r],A->ia_o[r+1]))
+        touched++;
+  } else {
+    // The row pointers outlive a released (real) component matrix
+    for(r=0;r<A->m;r++)
+      if(d->ia[r+1]>d->ia[r] || o->ia[r+1]>o->ia[r])
+        touched++;
+  }
+  MPI_Allreduce(&touched,&total,1,MPI_INT,MPI_SUM,PETSC_COMM_WORLD);
+  return total;
+}
+
+void benchmarkAssembly(MatrixAssembler *A, int reps)
+{
+  int i, r;
+  double t0, t_fused, t_axpy;
+  PetscReal norm_M, norm_diff;
+  PetscScalar c[A->Mc->num];
+  Mat W;
+
+  if(A->shell || A->padded) {
+    logOutput("# assembly benchmark '%s' skipped for matrix-free or padded storage\n",A->name);
+    return;
+  }
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if(A->Mc->matrix[i]==NULL) {
+      logOutput("# assembly benchmark '%s' skipped, component matricies were released\n",A->name);
+      return;
+    }
+  }
+  getCoefficients(A,0,c);
+
+  MPI_Barrier(PETSC_COMM_WORLD);
+  t0 = MPI_Wtime();
+  for(r=0;r<reps;r++)
+    combineComponents(A,c);
+  MPI_Barrier(PETSC_COMM_WORLD);
+  t_fused = MPI_Wtime()-t0;
+
+  // The previous assembly: one full MatAXPY pass over the target per component
+  MatDuplicate(A->M,MAT_DO_NOT_COPY_VALUES,&W);
+  MPI_Barrier(PETSC_COMM_WORLD);
+  t0 = MPI_Wtime();
+  for(r=0;r<reps;r++)
+  {
+    MatZeroEntries(W);
+    for(i=0;i<A->Mc->num;i++)
+      MatAXPY(W,c[i],A->Mc->matrix[i],DIFFERENT_NONZERO_PATTERN);
+    MatAssemblyBegin(W,MAT_FINAL_ASSEMBLY);
+    MatAssemblyEnd(W,MAT_FINAL_ASSEMBLY);
+  }
+  MPI_Barrier(PETSC_COMM_WORLD);
+  t_axpy = MPI_Wtime()-t0;
+
+  MatNorm(A->M,NORM_FROBENIUS,&norm_M);
+  MatAXPY(W,-1,A->M,DIFFERENT_NONZERO_PATTERN);
+  MatNorm(W,NORM_FROBENIUS,&norm_diff);
+  MatDestroy(&W);
+
+  logOutput("# assembly benchmark '%s' (%d reps): fused %E secs, MatAXPY chain %E secs, speedup %.2f, rel. diff %E\n",
+            A->name,reps,t_fused/reps,t_axpy/reps,t_axpy/t_fused,norm_M>0 ? norm_diff/norm_M : norm_diff);
+}
+
+void deleteAssembler(MatrixAssembler *A)
+{
+  int i;
+  if(A->shell) {
+    VecDestroy( &(A->work) );
+    MatDestroy( &(A->M) );
+    free(A->coef);
+    free(A);
+    return;
+  }
+  for(i=0; i < A->Mc->num; i++) {
+    MatDestroy( &(A->map[i].P) );
+    freeComponentBlock(&(A->map[i].d));
+    freeComponentBlock(&(A->map[i].o));
+  }
+  free(A->ia_d);
+  free(A->ia_o);
+  free(A->S_d);
+  free(A->S_o);
+  free(A->R_d);
+  free(A->R_o);
+  free(A->coef);
+  MatDestroy( &(A->M) );
+  free(A);
+}
@@ -0,0 +1,182 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Assembly of the total matricies (E, D, and K) from their scaled
+// components on a fixed union nonzero pattern
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_ASSEMBLE
+#define QEPPS_ASSEMBLE
+
+/*!
+ *  One local block (diagonal or off-diagonal part of the MPIAIJ storage) of a component. Entry
+ *  k of the block lands at map[k] of the corresponding block of the total matrix (with padded
+ *  storage, entries are bs x bs blocks). When the component already has the union pattern of
+ *  the block the map is dropped (NULL). The values are either complex (val, checked out of the
+ *  component Mat during assembly only) or real (re, owned here).
+ */
+typedef struct
+{
+  PetscInt nnz;
+  PetscInt *ia;            // Component row pointers
+  PetscInt *map;
+  PetscScalar *val;
+  PetscReal *re;
+} ComponentBlock;
+
+typedef struct
+{
+  ComponentBlock d, o;
+  bool real;               // All values have a zero imaginary part
+  int slot;                // Position within the complex or real group of the stacked storage
+  Mat P;                   // Component in the blocked format on its own pattern (padded storage only)
+} ComponentMap;
+
+typedef enum
+{
+  ASSEMBLY_SKIPPED=0,      // Coefficients unchanged, M left as is
+  ASSEMBLY_DELTA,          // Only the components whose coefficient changed were applied
+  ASSEMBLY_FULL            // M rebuilt from all components
+} AssemblyStatus;
+
+/*!
+ *  Assembly options read from the QEPPS options table in the LUA state
+ */
+typedef struct
+{
+  bool matrix_free;        // E, D, and K are MATSHELL operators applying sum_i c_i*M_i*x
+  bool stacked;            // Component values are stored interleaved on the union pattern
+  bool real;               // Purely real components are stored as real values
+  bool blocked;            // Components are stored in a blocked format when a block size is found
+  int block_size;          // Block size to use, 0 detects it from the components
+  int field_block_size;    // Block size the (AIJ) totals carry from their creation, 1 for none
+} AssemblyOptions;
+
+typedef struct
+{
+  const char *name;        // Key of the matrix in the LUA matricies table
+  MatrixComponent *Mc;     // Component matricies, entries are released (NULL) once copied out
+  Mat M;                   // Total matrix on the union nonzero pattern (or MATSHELL)
+  bool shell;              // M is a matrix-free operator, none of the fields below are set up
+  Vec work;                // Work vector for the matrix-free products
+  bool padded;             // M and the components (P) are MATBAIJ/MATSBAIJ, M on one shared pattern
+  PetscInt bs;             // Block size of the padded storage
+  bool stacked;            // Component values live in S/R, the component matricies are released
+  int nS, nR;              // Number of complex and real components in the stacked storage
+  PetscScalar *S_d, *S_o;  // Stacked complex values, S_X[k*nS+slot] is a component at union entry k
+  PetscReal *R_d, *R_o;    // Stacked real values, R_X[k*nR+slot]
+  PetscInt m;              // Local rows (block rows when padded)
+  PetscInt nd, no;         // Local nonzeros (blocks when padded) of M in the diagonal/off-diagonal blocks
+  PetscInt *ia_d, *ia_o;   // Row pointers of M
+  double exponent;         // Coefficients are multiplied by x^exponent of the parameter value x
+  int p_frozen;            // Parameter index the coefficients are always evaluated at, -1 for none
+  PetscScalar *coef;       // Coefficients M currently holds, valid once assembled
+  bool assembled;
+  int deltas;              // Delta updates since the last full assembly
+  int count[3];            // Number of updates by AssemblyStatus
+  ComponentMap map[];
+} MatrixAssembler;
+
+#define MATRIX_ASSEMBLER_SIZE(x) ( sizeof(MatrixAssembler)+sizeof(ComponentMap)*x )
+
+/*!
+ *  Fills opts from the QEPPS options table in the LUA state
+ */
+void getAssemblyOptionsLUA(AssemblyOptions *opts);
+
+/*!
+ *  Builds the union nonzero pattern of all components in Mc and the per-component index
+ *  maps into it. This is done once at setup, all later assembly only updates values in place.
+ *  With opts->matrix_free, M is instead a MATSHELL whose products are computed from the
+ *  components and the current coefficients, and no total matrix is ever stored. With
+ *  opts->stacked, the component values are copied interleaved onto the union pattern and the
+ *  component matricies in Mc are destroyed (set to NULL), so only one index structure remains.
+ *  With opts->real, components without an imaginary part keep only their real values and
+ *  their matricies are destroyed as well. With opts->field_block_size > 1, M carries that
+ *  block size from its preallocation on (PETSc does not allow setting it later).
+ */
+MatrixAssembler *createAssembler(const char *matrix_name, MatrixComponent *Mc, const AssemblyOptions *opts);
+
+/*!
+ *  Returns the union nonzero pattern (all zero values) of every component in the n
+ *  MatrixComponent's of Mc.
+ */
+Mat createSharedPattern(MatrixComponent **Mc, int n);
+
+/*!
+ *  Returns the largest block size bs (up to 8) for which every block row of pattern is made of
+ *  bs identical rows of whole, aligned bs x bs blocks, or 1 if there is none. A requested bs > 1
+ *  is only checked. The outcome is logged.
+ */
+PetscInt detectBlockSize(Mat pattern, PetscInt bs);
+
+/*!
+ *  Counterpart of createAssembler() storing every component in a blocked format with block
+ *  size bs: MATSBAIJ keeping only the upper triangle when the components are all complex
+ *  symmetric, MATBAIJ otherwise. Each component keeps its own pattern, the component
+ *  matricies in Mc are released. M has the same format on pattern (see createSharedPattern()),
+ *  so every total matrix built on the same pattern can be combined with SAME_NONZERO_PATTERN.
+ *  Each component block is mapped to its block of M at setup, assembly streams the bs x bs
+ *  values of every block into place.
+ */
+MatrixAssembler *createPaddedAssembler(const char *matrix_name, MatrixComponent *Mc, Mat pattern,
+                                       bool symmetric, PetscInt bs);
+
+/*!
+ *  Multiplies the coefficients of every later assembly by x^exponent of the parameter value x
+ *  (see separable.h). With p_frozen >= 0 they are always taken at that parameter index, for a
+ *  matrix that the scaling makes constant. Forces a full assembly next.
+ */
+void setAssemblerScaling(MatrixAssembler *A, double exponent, int p_frozen);
+
+/*!
+ *  Computes M = sum_i c[i]*M_i in a single pass over the local value arrays of M. For a
+ *  matrix-free operator only the coefficients are replaced.
+ */
+void combineComponents(MatrixAssembler *A, const PetscScalar *c);
+
+/*!
+ *  Brings the total matrix up to date for the p-th parameter value using the coefficients
+ *  cached from the previous call. Nothing is done when the coefficients are unchanged, and
+ *  only the changed components are applied (as scaled differences) when some are. Returns
+ *  what was done.
+ */
+AssemblyStatus updateMatrix(MatrixAssembler *A, int p);
+
+/*!
+ *  Finds the components whose coefficient is not the same at every parameter of the table and
+ *  adds one to mark at the rows and columns of each of their nonzeros (both sides of the
+ *  diagonal with symmetric storage). M is used to hold each component in turn, so the next
+ *  update is a full assembly. Returns the number of such components.
+ */
+int markVaryingRows(MatrixAssembler *A, Vec mark);
+
+/*!
+ *  Returns the number of rows where component i has a nonzero, from whatever storage the
+ *  assembler kept of it (the component matrix may have been released). Collective.
+ */
+int componentRows(MatrixAssembler *A, int i);
+
+/*!
+ *  Times reps assemblies at the first parameter value with the fused kernel against the
+ *  equivalent chain of MatAXPY() calls and logs both, along with their relative difference.
+ */
+void benchmarkAssembly(MatrixAssembler *A, int reps);
+
+/*!
+ *  Frees the index maps, copied values, and the total matrix. Component matricies that were
+ *  not released are left to deleteMatrix().
+ */
+void deleteAssembler(MatrixAssembler *A);
+
+#endif
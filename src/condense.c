@@ -0,0 +1,238 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Static condensation of the shifted factor onto the rows touched by
+// parameter-dependent components
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include <petscblaslapack.h>
+#include <grvy.h>
+#include "types.h"
+#include "condense.h"
+#include "log.h"
+
+CondensedFactor *createCondensedFactor(Mat P, Vec mark, int max_size)
+{
+  PetscInt rstart, rend, r, n=0, *rows, size;
+  PetscScalar *a;
+  MPI_Comm comm = PetscObjectComm((PetscObject)P);
+  Vec full;
+
+  MatGetOwnershipRange(P,&rstart,&rend);
+  rows = malloc( (rend-rstart>0 ? rend-rstart : 1)*sizeof(PetscInt) );
+  if (rows==NULL)
+    logError("#! Allocation of the condensed factor failed\n");
+  VecGetArray(mark,&a);
+  for(r=rstart;r<rend;r++)
+    if(a[r-rstart]!=0)
+      rows[n++] = r;
+  VecRestoreArray(mark,&a);
+  MPI_Allreduce(&n,&size,1,MPIU_INT,MPI_SUM,comm);
+  if(size==0 || size>max_size) {
+    free(rows);
+    return NULL;
+  }
+
+  CondensedFactor *c = malloc( sizeof(CondensedFactor) );
+  if (c==NULL)
+    logError("#! Allocation of the condensed factor failed\n");
+  ISCreateGeneral(comm,n,rows,PETSC_COPY_VALUES,&(c->interface));
+  ISComplement(c->interface,rstart,rend,&(c->interior));
+  free(rows);
+  c->size = size;
+
+  // Each rank keeps its own rows of both blocks
+  VecCreateMPI(comm,rend-rstart-n,PETSC_DETERMINE,&(c->xi));
+  VecDuplicate(c->xi,&(c->zi));
+  VecCreateMPI(comm,n,PETSC_DETERMINE,&(c->xg));
+  VecDuplicate(c->xg,&(c->tg));
+  MatGetVecs(P,&full,NULL);
+  VecScatterCreate(full,c->interior,c->xi,NULL,&(c->to_interior));
+  VecScatterCreate(full,c->interface,c->xg,NULL,&(c->to_interface));
+  VecDestroy(&full);
+  VecScatterCreateToAll(c->xg,&(c->gather),&(c->all));
+
+  c->C = malloc( size*size*sizeof(PetscScalar) );
+  c->S = malloc( size*size*sizeof(PetscScalar) );
+  c->pivots = malloc( size*sizeof(PetscBLASInt) );
+  c->g = malloc( size*sizeof(PetscScalar) );
+  c->h = malloc( size*sizeof(PetscScalar) );
+  if (c->C==NULL || c->S==NULL || c->pivots==NULL || c->g==NULL || c->h==NULL)
+    logError("#! Allocation of the condensed factor failed\n");
+  VecDuplicateVecs(c->xi,size,&(c->Y));
+  c->Aii = c->Aig = c->Agi = c->Agg = NULL;
+  c->F = NULL;
+  c->sigma = 0;
+  c->factored = c->refactored = false;
+  c->analyses = c->factorizations = c->complements = 0;
+  return c;
+}
+
+// out = v on every rank
+static void gatherInterface(CondensedFactor *c, Vec v, PetscScalar *out)
+{
+  PetscScalar *a;
+
+  VecScatterBegin(c->gather,v,c->all,INSERT_VALUES,SCATTER_FORWARD);
+  VecScatterEnd(c->gather,v,c->all,INSERT_VALUES,SCATTER_FORWARD);
+  VecGetArray(c->all,&a);
+  PetscMemcpy(out,a,c->size*sizeof(PetscScalar));
+  VecRestoreArray(c->all,&a);
+}
+
+// Factors Aii and condenses its columns of Aig, one solve per interface column
+static void factorInterior(CondensedFactor *c, Mat P, const char *package)
+{
+  MatFactorInfo info;
+  MatReuse reuse = c->Aii==NULL ? MAT_INITIAL_MATRIX : MAT_REUSE_MATRIX;
+  IS row=NULL, col=NULL;
+  PetscInt start, end;
+  int j;
+
+  MatGetSubMatrix(P,c->interior,c->interior,reuse,&(c->Aii));
+  MatGetSubMatrix(P,c->interior,c->interface,reuse,&(c->Aig));
+  MatGetSubMatrix(P,c->interface,c->interior,reuse,&(c->Agi));
+  MatFactorInfoInitialize(&info);
+  if(c->F==NULL) {
+    grvy_timer_begin("analysis");
+    MatGetFactor(c->Aii,package,MAT_FACTOR_LU,&(c->F));
+    if(c->F==NULL)
+      logError("#! Solver package '%s' can not factor the interior block\n",package);
+    if(strcmp(package,MATSOLVERPETSC)==0)
+      MatGetOrdering(c->Aii,MATORDERINGND,&row,&col);
+    MatLUFactorSymbolic(c->F,c->Aii,row,col,&info);
+    ISDestroy(&row);
+    ISDestroy(&col);
+    c->analyses++;
+    grvy_timer_end("analysis");
+  }
+
+  grvy_timer_begin("factor");
+  MatLUFactorNumeric(c->F,c->Aii,&info);
+  c->factorizations++;
+  VecGetOwnershipRange(c->xg,&start,&end);
+  for(j=0;j<c->size;j++)
+  {
+    VecSet(c->xg,0);
+    if(j>=start && j<end)
+      VecSetValue(c->xg,j,1,INSERT_VALUES);
+    VecAssemblyBegin(c->xg);
+    VecAssemblyEnd(c->xg);
+    MatMult(c->Aig,c->xg,c->xi);
+    MatSolve(c->F,c->xi,c->Y[j]);
+    MatMult(c->Agi,c->Y[j],c->tg);
+    gatherInterface(c,c->tg,&(c->C[j*c->size]));
+  }
+  grvy_timer_end("factor");
+}
+
+void factorCondensed(CondensedFactor *c, Mat P, PetscScalar sigma, const char *package)
+{
+  PetscInt start, end, r, k, nc;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  PetscBLASInt bn, info;
+  int i, n=c->size;
+
+  // Only the interface rows and columns depend on the parameter
+  c->refactored = !c->factored || sigma!=c->sigma;
+  if(c->refactored) {
+    factorInterior(c,P,package);
+    c->sigma = sigma;
+    c->factored = true;
+  }
+
+  grvy_timer_begin("factor");
+  MatGetSubMatrix(P,c->interface,c->interface,c->Agg==NULL ? MAT_INITIAL_MATRIX : MAT_REUSE_MATRIX,&(c->Agg));
+  memset(c->S,0,n*n*sizeof(PetscScalar));
+  MatGetOwnershipRange(c->Agg,&start,&end);
+  for(r=start;r<end;r++)
+  {
+    MatGetRow(c->Agg,r,&nc,&cols,&vals);
+    for(k=0;k<nc;k++)
+      c->S[r+cols[k]*n] = vals[k];
+    MatRestoreRow(c->Agg,r,&nc,&cols,&vals);
+  }
+  MPI_Allreduce(MPI_IN_PLACE,c->S,n*n,MPIU_SCALAR,MPIU_SUM,PetscObjectComm((PetscObject)P));
+  for(i=0;i<n*n;i++)
+    c->S[i] -= c->C[i];
+  PetscBLASIntCast(n,&bn);
+  LAPACKgetrf_(&bn,&bn,c->S,&bn,c->pivots,&info);
+  if(info!=0)
+    logError("#! The Schur complement of the interface is singular at this shift\n");
+  c->complements++;
+  grvy_timer_end("factor");
+}
+
+void applyCondensed(CondensedFactor *c, Vec x, Vec y)
+{
+  PetscInt start, end, r;
+  PetscBLASInt bn, one=1, info;
+  PetscScalar *a;
+  int j;
+
+  VecScatterBegin(c->to_interior,x,c->xi,INSERT_VALUES,SCATTER_FORWARD);
+  VecScatterEnd(c->to_interior,x,c->xi,INSERT_VALUES,SCATTER_FORWARD);
+  VecScatterBegin(c->to_interface,x,c->xg,INSERT_VALUES,SCATTER_FORWARD);
+  VecScatterEnd(c->to_interface,x,c->xg,INSERT_VALUES,SCATTER_FORWARD);
+
+  // g = x_g - Agi Aii^-1 x_i, solved redundantly with the dense Schur complement
+  MatSolve(c->F,c->xi,c->zi);
+  MatMult(c->Agi,c->zi,c->tg);
+  VecAYPX(c->tg,-1,c->xg);
+  gatherInterface(c,c->tg,c->g);
+  PetscBLASIntCast(c->size,&bn);
+  LAPACKgetrs_("N",&bn,&one,c->S,&bn,c->pivots,c->g,&bn,&info);
+
+  // y_i = z - Y y_g
+  for(j=0;j<c->size;j++)
+    c->h[j] = -c->g[j];
+  VecMAXPY(c->zi,c->size,c->h,c->Y);
+  VecGetOwnershipRange(c->xg,&start,&end);
+  VecGetArray(c->xg,&a);
+  for(r=start;r<end;r++)
+    a[r-start] = c->g[r];
+  VecRestoreArray(c->xg,&a);
+
+  VecScatterBegin(c->to_interior,c->zi,y,INSERT_VALUES,SCATTER_REVERSE);
+  VecScatterEnd(c->to_interior,c->zi,y,INSERT_VALUES,SCATTER_REVERSE);
+  VecScatterBegin(c->to_interface,c->xg,y,INSERT_VALUES,SCATTER_REVERSE);
+  VecScatterEnd(c->to_interface,c->xg,y,INSERT_VALUES,SCATTER_REVERSE);
+}
+
+void deleteCondensedFactor(CondensedFactor *c)
+{
+  ISDestroy(&(c->interior));
+  ISDestroy(&(c->interface));
+  MatDestroy(&(c->Aii));
+  MatDestroy(&(c->Aig));
+  MatDestroy(&(c->Agi));
+  MatDestroy(&(c->Agg));
+  MatDestroy(&(c->F));
+  VecDestroyVecs(c->size,&(c->Y));
+  VecDestroy(&(c->xi));
+  VecDestroy(&(c->zi));
+  VecDestroy(&(c->xg));
+  VecDestroy(&(c->tg));
+  VecDestroy(&(c->all));
+  VecScatterDestroy(&(c->to_interior));
+  VecScatterDestroy(&(c->to_interface));
+  VecScatterDestroy(&(c->gather));
+  free(c->C);
+  free(c->S);
+  free(c->pivots);
+  free(c->g);
+  free(c->h);
+  free(c);
+}
@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Static condensation of the shifted factor onto the rows touched by
+// parameter-dependent components
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_CONDENSE
+#define QEPPS_CONDENSE
+
+typedef struct
+{
+  IS interior;             // Rows no parameter-dependent component touches
+  IS interface;            // Rows (and columns) one does
+  int size;                // Global size of the interface
+  Mat Aii, Aig, Agi, Agg;  // Blocks of the shifted matrix, all but Agg fixed at a fixed shift
+  Mat F;                   // Factor of Aii
+  PetscScalar sigma;       // Shift F, Y, and C were computed for
+  bool factored;
+  bool refactored;         // The last factorCondensed() factored Aii
+  Vec *Y;                  // Aii^-1 Aig e_j for every interface column j
+  PetscScalar *C;          // Agi Aii^-1 Aig, on every rank (column major)
+  PetscScalar *S;          // LU factors of the Schur complement Agg - C
+  PetscBLASInt *pivots;
+  PetscScalar *g, *h;      // Work arrays
+  Vec xi, zi, xg, tg;      // Work vectors in the interior and interface layouts
+  VecScatter to_interior, to_interface, gather;
+  Vec all;                 // An interface vector on every rank
+  int analyses;            // Ordering and symbolic factorizations of Aii
+  int factorizations;      // Numeric factorizations of Aii
+  int complements;         // Schur complements factored
+} CondensedFactor;
+
+/*!
+ *  Splits the rows of P into the interface, where mark is nonzero, and the interior. Returns
+ *  NULL when the interface is empty or larger than max_size, as the Schur complement is stored
+ *  dense on every rank. P must be MATMPIAIJ (not padded).
+ */
+CondensedFactor *createCondensedFactor(Mat P, Vec mark, int max_size);
+
+/*!
+ *  Condenses P onto the interface. Aii is only factored (timers "analysis" and "factor") when
+ *  the shift differs from the last call, along with one solve per interface column for
+ *  Y and C. Every call factors the Schur complement Agg - C of the current P.
+ */
+void factorCondensed(CondensedFactor *c, Mat P, PetscScalar sigma, const char *package);
+
+/*!
+ *  y = P^-1 x by block elimination: z = Aii^-1 x_i, y_g = S^-1 (x_g - Agi z), y_i = z - Y y_g
+ */
+void applyCondensed(CondensedFactor *c, Vec x, Vec y);
+
+void deleteCondensedFactor(CondensedFactor *c);
+
+#endif
@@ -113,12 +113,33 @@ double complex getOptComplexLUA(const char *option,double complex default_value)
     lua_pop(L,2); //pop value and table
   } else {
     result=default_value;
-    logOutput("# LUA: '%s[%s]' is not a double complex, using default: %f%+fj\n",creal(result),cimag(result));
+    logOutput("# LUA: '%s[%s]' is not a double complex, using default: %f%+fj\n",LUA_array_options,option,creal(result),cimag(result));
     lua_pop(L,1); //pop table
   }
   return result;
 }
 
+int getOptComplexListLUA(const char *option, double complex *values, int max)
+{
+  int i, n=0;
+  pullFromTableLUA(LUA_array_options,option);
+  if ( lua_istable(L,-1) ) {
+    n = lua_rawlen(L,-1);
+    for(i=0; i<n && i<max; i++)
+    {
+      lua_rawgeti(L,-1,i+1);
+      values[i]=returnComplexLUA();
+      lua_pop(L,1); //pop value
+    }
+  } else if ( lua_type(L,-1) == LUA_TNUMBER || lua_type(L,-1) == LUA_TUSERDATA ) {
+    n = 1;
+    if(max>0)
+      values[0]=returnComplexLUA();
+  }
+  lua_pop(L,2); //pop value and table
+  return n;
+}
+
 int getOptIntLUA(const char *option,int default_value)
 {
   int result;
@@ -128,7 +149,7 @@ int getOptIntLUA(const char *option,int default_value)
     lua_pop(L,2); //pop value and table
   } else {
     result=default_value;
-    logOutput("# LUA: '%s[%s]' is not an int, using default: %i\n",result);
+    logOutput("# LUA: '%s[%s]' is not an int, using default: %i\n",LUA_array_options,option,result);
     lua_pop(L,1); //pop table
   }
   return result;
@@ -147,6 +168,18 @@ int getNumberOfParameters()
   return getAraryLengthLUA(LUA_array_parameters);
 }
 
+int appendParameterValue(double x)
+{
+  int index = getNumberOfParameters();
+  lua_getglobal(L,LUA_array_parameters);
+  if (!lua_istable(L, -1))
+    logError("#! LUA: '%s' is not an array\n", LUA_array_parameters);
+  lua_pushnumber(L,x);
+  lua_rawseti(L,-2,index+1);
+  lua_pop(L,1); //pop table
+  return index;
+}
+
 void startLUA(void)
 {
   if(L==NULL) {
@@ -205,11 +238,22 @@ double complex funcParamValue(const char* matrix_name, int p, int m)
   return result;
 }
 
+// Complex symmetric (A = A^T, not Hermitian) up to rounding in the exported values
+static bool isSymmetricMatrix(Mat A)
+{
+  PetscReal norm;
+  PetscBool symmetric;
+  MatNorm(A,NORM_INFINITY,&norm);
+  MatIsSymmetric(A,100*PETSC_MACHINE_EPSILON*norm,&symmetric);
+  return symmetric;
+}
+
 MatrixComponent *parseConfigMatrixLUA(const char* matrix_name)
 {
   int Nfiles, Nfuncs, i, m, n;
   char filename[PETSC_MAX_PATH_LEN];
   PetscViewer viewer;
+  bool check_symmetry = getOptBooleanLUA("symmetric_storage",false);
   
   lua_getglobal(L,LUA_table_matricies);
   if ( !lua_istable(L,-1) )
@@ -241,6 +285,7 @@ MatrixComponent *parseConfigMatrixLUA(const char* matrix_name)
   if (M==NULL)
     logError("#! Allocation of MatrixComponent container for '%s' failed\n",matrix_name);
   M->num = Nfiles;
+  M->symmetric = check_symmetry;
   
   for(i=0; i < M->num; i++)
   {
@@ -255,6 +300,10 @@ MatrixComponent *parseConfigMatrixLUA(const char* matrix_name)
       
       MatGetSize(M->matrix[i],&m,&n);
       logOutput("# %dx%d matrix loaded from '%s'\n",m,n,filename);
+      if( check_symmetry && !isSymmetricMatrix(M->matrix[i]) ) {
+        logOutput("# '%s' is not symmetric\n",filename);
+        M->symmetric = false;
+      }
     } else {
       logError("#! LUA: Non-string type found in '%s[%s][%s]'\n",LUA_table_matricies,matrix_name,LUA_subkey_data);
     }
@@ -28,6 +28,11 @@ double complex getParameterValue(int index);
  */
 int getNumberOfParameters();
 
+/*! 
+ *  Appends the real value x to the parameters table in the LUA state and returns its index
+ */
+int appendParameterValue(double x);
+
 /*! 
  *  Returns a string from the QEPPS options table in the LUA state, returns default_value
  *  if option is not defined
@@ -48,6 +53,13 @@ bool getOptBooleanLUA(const char *option, bool default_value);
  */
 double complex getOptComplexLUA(const char *option,double complex default_value);
 
+/*! 
+ *  Reads option from the QEPPS options table in the LUA state as a list of complex doubles
+ *  (an array, or a single number) into values, at most max of them. Returns the length of the
+ *  list, 0 if option is not defined.
+ */
+int getOptComplexListLUA(const char *option, double complex *values, int max);
+
 /*! 
  *  Returns an int from the QEPPS options table in the LUA state, returns default_value
  *  if option is not defined
@@ -85,7 +97,8 @@ void parseConfigLUA(const char* filename);
 double complex funcParamValue(const char* matrix_name, int p, int m);
 
 /*!
- *  Parses and loads the matricies from the data files specified in LUA
+ *  Parses and loads the matricies from the data files specified in LUA. If the symmetric_storage
+ *  option is set, each matrix is also checked for (complex) symmetry.
  */
 MatrixComponent *parseConfigMatrixLUA(const char* matrix_name);
 
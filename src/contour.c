@@ -0,0 +1,411 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Contour-integral (Beyn) solver for all eigenvalues inside a region, with
+// the quadrature nodes factored concurrently on subcommunicators
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include <grvy.h>
+#include "types.h"
+#include "contour.h"
+#include "config.h"
+#include "log.h"
+
+// Singular values of the zeroth moment counted as eigenvalues, relative to the largest. The
+// Gram matrix squares them, so this stays well above the square root of the machine epsilon.
+#define CONTOUR_RANK_TOL 1e-6
+
+// Slack on the unit circle of the normalized eigenvalue for points on the contour
+#define CONTOUR_EDGE 1e-10
+
+ContourSolver *createContourSolver(void)
+{
+  int size;
+  double radius = creal(getOptComplexLUA("contour_radius",0));
+  double complex lower = getOptComplexLUA("contour_lower",0);
+  double complex upper = getOptComplexLUA("contour_upper",0);
+
+  if( radius<=0 && lower==upper )
+    return NULL;
+  ContourSolver *c = malloc( sizeof(ContourSolver) );
+  if (c==NULL)
+    logError("#! Allocation of the contour solver failed\n");
+  c->rectangle = radius<=0;
+  c->lower = lower;
+  c->upper = upper;
+  if( c->rectangle )
+  {
+    if( creal(upper)<=creal(lower) || cimag(upper)<=cimag(lower) )
+      logError("#! contour_upper must lie above and right of contour_lower\n");
+    c->center = (lower+upper)/2;
+    c->radius = cabs(upper-lower)/2;
+  }
+  else
+  {
+    c->center = getOptComplexLUA("contour_center",0);
+    c->radius = radius;
+  }
+  c->nodes = getOptIntLUA("contour_nodes",32);
+  c->columns = getOptIntLUA("contour_columns",16);
+  c->groups = getOptIntLUA("contour_groups",1);
+  c->tol = creal(getOptComplexLUA("contour_tolerance",1e-6));
+  if( c->nodes<1 || c->columns<1 )
+    logError("#! contour_nodes and contour_columns must be positive\n");
+  if( c->groups<1 )
+    c->groups = 1;
+  MPI_Comm_size(PETSC_COMM_WORLD,&size);
+  if( size%c->groups!=0 )
+    logError("#! contour_groups (%i) must divide the number of ranks solving together (%i)\n",c->groups,size);
+  c->lambda = malloc( sizeof(PetscScalar)*c->columns );
+  if (c->lambda==NULL)
+    logError("#! Allocation of the contour solver failed\n");
+  c->setup = false;
+  c->count = c->nfound = 0;
+  c->worst = 0;
+  c->saturated = false;
+  logOutput("# contour: circle at %.3f%+.3fj of radius %.3E%s, %i nodes on %i subcommunicators, %i probing vectors\n",
+            creal(c->center),cimag(c->center),c->radius,c->rectangle ? " around the rectangle" : "",
+            c->nodes,c->groups,c->columns);
+  return c;
+}
+
+// Entry (i,j) of the probing vectors, hashed from the global position so that every layout
+// (and every subcommunicator) builds the same vectors
+static PetscScalar probeEntry(PetscInt i, int j)
+{
+  unsigned long long h = (unsigned long long)i*0x9E3779B97F4A7C15ULL + (unsigned long long)j*0xC2B2AE3D27D4EB4FULL + 1;
+  h ^= h>>33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h>>33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h>>33;
+  return (double)(h&0xFFFF)/0xFFFF-0.5 + PETSC_i*((double)((h>>16)&0xFFFF)/0xFFFF-0.5);
+}
+
+static void setupContour(ContourSolver *c, Mat K, Mat D, Mat E)
+{
+  int j, rank, subrank, subsize;
+  PetscInt i, start, end, nloc, N;
+  PetscScalar *v;
+  PetscBool upper;
+  PC pc;
+
+  // Every subcommunicator gets its own copy of the operators
+  if( c->groups>1 )
+  {
+    MatGetRedundantMatrix(K,c->groups,MPI_COMM_NULL,MAT_INITIAL_MATRIX,&(c->Ks));
+    MatGetRedundantMatrix(D,c->groups,MPI_COMM_NULL,MAT_INITIAL_MATRIX,&(c->Ds));
+    MatGetRedundantMatrix(E,c->groups,MPI_COMM_NULL,MAT_INITIAL_MATRIX,&(c->Es));
+    PetscObjectGetComm((PetscObject)c->Ks,&(c->subcomm));
+  }
+  else
+  {
+    PetscObjectReference((PetscObject)K);
+    PetscObjectReference((PetscObject)D);
+    PetscObjectReference((PetscObject)E);
+    c->Ks = K;
+    c->Ds = D;
+    c->Es = E;
+    c->subcomm = PETSC_COMM_WORLD;
+  }
+  MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  MPI_Comm_rank(c->subcomm,&subrank);
+  MPI_Comm_size(c->subcomm,&subsize);
+  MPI_Comm_split(PETSC_COMM_WORLD,subrank,rank,&(c->across));
+  MPI_Comm_rank(c->across,&(c->group));
+
+  // Shifted matrix on the union pattern of the three
+  MatDuplicate(c->Ks,MAT_COPY_VALUES,&(c->T));
+  MatAXPY(c->T,1,c->Ds,DIFFERENT_NONZERO_PATTERN);
+  MatAXPY(c->T,1,c->Es,DIFFERENT_NONZERO_PATTERN);
+  KSPCreate(c->subcomm,&(c->ksp));
+  KSPSetOptionsPrefix(c->ksp,"contour_");
+  KSPSetType(c->ksp,KSPPREONLY);
+  KSPGetPC(c->ksp,&pc);
+  // Symmetric storage only holds the upper triangle, which takes an LDL^T factorization
+  PetscObjectTypeCompareAny((PetscObject)c->T,&upper,MATSEQSBAIJ,MATMPISBAIJ,"");
+  PCSetType(pc,upper ? PCCHOLESKY : PCLU);
+  if( subsize>1 )
+    PCFactorSetMatSolverPackage(pc,MATSOLVERMUMPS);
+  KSPSetFromOptions(c->ksp);
+
+  MatGetVecs(c->T,&(c->x),NULL);
+  VecDuplicateVecs(c->x,c->columns,&(c->probe));
+  VecDuplicateVecs(c->x,c->columns,&(c->A0));
+  VecDuplicateVecs(c->x,c->columns,&(c->A1));
+  VecGetOwnershipRange(c->x,&start,&end);
+  for(j=0;j<c->columns;j++)
+  {
+    VecGetArray(c->probe[j],&v);
+    for(i=start;i<end;i++)
+      v[i-start] = probeEntry(i,j);
+    VecRestoreArray(c->probe[j],&v);
+  }
+
+  MatGetVecs(K,&(c->w[0]),NULL);
+  for(j=1;j<3;j++)
+    VecDuplicate(c->w[0],&(c->w[j]));
+  VecDuplicateVecs(c->w[0],c->columns,&(c->M0));
+  VecDuplicateVecs(c->w[0],c->columns,&(c->M1));
+  VecDuplicateVecs(c->w[0],c->columns,&(c->U));
+
+  // The first subcommunicator's vectors, seen in rank order from the whole communicator
+  VecGetLocalSize(c->x,&nloc);
+  VecGetSize(c->x,&N);
+  VecCreateMPIWithArray(PETSC_COMM_WORLD,1,c->group==0 ? nloc : 0,N,NULL,&(c->view));
+  VecScatterCreate(c->view,NULL,c->w[0],NULL,&(c->gather));
+
+  DSCreate(PETSC_COMM_SELF,&(c->ds[0]));
+  DSSetType(c->ds[0],DSHEP);
+  DSAllocate(c->ds[0],c->columns);
+  DSCreate(PETSC_COMM_SELF,&(c->ds[1]));
+  DSSetType(c->ds[1],DSNHEP);
+  DSAllocate(c->ds[1],c->columns);
+  c->setup = true;
+}
+
+// Moments of the nodes of this subcommunicator, summed over all of them and gathered into the
+// layout of the operators
+static void integrate(ContourSolver *c, double complex center, double radius)
+{
+  int k, j, L=c->columns;
+  double complex zeta, z;
+  PetscInt nloc;
+  PetscScalar *v;
+  Vec A, M;
+
+  for(j=0;j<L;j++)
+  {
+    VecSet(c->A0[j],0);
+    VecSet(c->A1[j],0);
+  }
+  for(k=c->group;k<c->nodes;k+=c->groups)
+  {
+    zeta = cexp(2*M_PI*I*(k+0.5)/c->nodes);
+    z = center+radius*zeta;
+    MatZeroEntries(c->T);
+    MatAXPY(c->T,1,c->Ks,SUBSET_NONZERO_PATTERN);
+    MatAXPY(c->T,TO_PETSC_COMPLEX(z),c->Ds,SUBSET_NONZERO_PATTERN);
+    MatAXPY(c->T,TO_PETSC_COMPLEX(z*z),c->Es,SUBSET_NONZERO_PATTERN);
+    KSPSetOperators(c->ksp,c->T,c->T);
+    for(j=0;j<L;j++)
+    {
+      KSPSolve(c->ksp,c->probe[j],c->x);
+      VecAXPY(c->A0[j],TO_PETSC_COMPLEX(radius*zeta/c->nodes),c->x);
+      VecAXPY(c->A1[j],TO_PETSC_COMPLEX(radius*zeta*zeta/c->nodes),c->x);
+    }
+  }
+
+  for(j=0;j<2*L;j++)
+  {
+    A = j<L ? c->A0[j] : c->A1[j-L];
+    M = j<L ? c->M0[j] : c->M1[j-L];
+    VecGetLocalSize(A,&nloc);
+    VecGetArray(A,&v);
+    if( c->groups>1 )
+      MPI_Allreduce(MPI_IN_PLACE,v,nloc,MPIU_SCALAR,MPIU_SUM,c->across);
+    VecPlaceArray(c->view,v);
+    VecScatterBegin(c->gather,c->view,M,INSERT_VALUES,SCATTER_FORWARD);
+    VecScatterEnd(c->gather,c->view,M,INSERT_VALUES,SCATTER_FORWARD);
+    VecResetArray(c->view);
+    VecRestoreArray(A,&v);
+  }
+}
+
+// Relative residual |(K + l*D + l^2*E)u| / (|Ku| + |l||Du| + |l|^2|Eu|)
+static PetscReal relativeResidual(ContourSolver *c, Mat K, Mat D, Mat E, PetscScalar l, Vec u)
+{
+  PetscReal norm[4], al=PetscAbsScalar(l);
+
+  MatMult(K,u,c->w[0]);
+  MatMult(D,u,c->w[1]);
+  MatMult(E,u,c->w[2]);
+  VecNorm(c->w[0],NORM_2,&norm[0]);
+  VecNorm(c->w[1],NORM_2,&norm[1]);
+  VecNorm(c->w[2],NORM_2,&norm[2]);
+  VecAXPY(c->w[0],l,c->w[1]);
+  VecAXPY(c->w[0],l*l,c->w[2]);
+  VecNorm(c->w[0],NORM_2,&norm[3]);
+  return norm[3]/(norm[0]+al*norm[1]+al*al*norm[2]);
+}
+
+int solveContour(ContourSolver *c, Mat K, Mat D, Mat E, double complex scale)
+{
+  int i, j, a, b, k, L=c->columns, order[c->columns];
+  double complex center=c->center*scale, lambda;
+  double radius=c->radius*cabs(scale);
+  PetscInt ld;
+  PetscScalar G[L*L], H[L*L], HW[L*L], W[L*L], y[L], *A, *X, eig[L], eigi[L], mu, swap;
+  PetscReal sigma[L], residual;
+  Vec tmp;
+
+  if( !c->setup )
+    setupContour(c,K,D,E);
+  else if( c->groups>1 )
+  {
+    MatGetRedundantMatrix(K,c->groups,c->subcomm,MAT_REUSE_MATRIX,&(c->Ks));
+    MatGetRedundantMatrix(D,c->groups,c->subcomm,MAT_REUSE_MATRIX,&(c->Ds));
+    MatGetRedundantMatrix(E,c->groups,c->subcomm,MAT_REUSE_MATRIX,&(c->Es));
+  }
+  grvy_timer_begin("contour");
+  integrate(c,center,radius);
+
+  // Gram matrices G = M0^H M0 and H = M0^H M1
+  for(j=0;j<L;j++)
+  {
+    VecMDot(c->M0[j],L,c->M0,G+j*L);
+    VecMDot(c->M1[j],L,c->M0,H+j*L);
+  }
+
+  // Singular values and right singular vectors of M0 from G = W S^2 W^H, largest first
+  DSSetDimensions(c->ds[0],L,0,0,0);
+  DSGetLeadingDimension(c->ds[0],&ld);
+  DSGetArray(c->ds[0],DS_MAT_A,&A);
+  for(j=0;j<L;j++)
+    for(i=0;i<L;i++)
+      A[j*ld+i] = G[j*L+i];
+  DSRestoreArray(c->ds[0],DS_MAT_A,&A);
+  DSSetState(c->ds[0],DS_STATE_RAW);
+  DSSolve(c->ds[0],eig,NULL);
+  DSVectors(c->ds[0],DS_MAT_X,NULL,NULL);
+  DSGetArray(c->ds[0],DS_MAT_X,&X);
+  for(j=0;j<L;j++)
+  {
+    order[j] = j;
+    sigma[j] = PetscSqrtReal(PetscMax(PetscRealPart(eig[j]),0));
+  }
+  for(j=1;j<L;j++)
+    for(i=j;i>0 && sigma[order[i]]>sigma[order[i-1]];i--)
+    {
+      a = order[i];
+      order[i] = order[i-1];
+      order[i-1] = a;
+    }
+  for(j=0;j<L;j++)
+    for(i=0;i<L;i++)
+      W[j*L+i] = X[order[j]*ld+i];
+  DSRestoreArray(c->ds[0],DS_MAT_X,&X);
+  for(c->count=0;c->count<L;c->count++)
+    if( sigma[order[c->count]]<=CONTOUR_RANK_TOL*sigma[order[0]] || sigma[order[0]]==0 )
+      break;
+  c->saturated = c->count==L;
+  k = c->count;
+
+  // Reduced pencil B = S^-1 W^H H W S^-1 of the k dominant directions
+  c->nfound = 0;
+  c->worst = 0;
+  if( k>0 )
+  {
+    for(b=0;b<k;b++)
+      for(i=0;i<L;i++)
+      {
+        HW[b*L+i] = 0;
+        for(j=0;j<L;j++)
+          HW[b*L+i] += H[j*L+i]*W[b*L+j];
+      }
+    DSSetDimensions(c->ds[1],k,0,0,0);
+    DSGetLeadingDimension(c->ds[1],&ld);
+    DSGetArray(c->ds[1],DS_MAT_A,&A);
+    for(b=0;b<k;b++)
+      for(a=0;a<k;a++)
+      {
+        A[b*ld+a] = 0;
+        for(i=0;i<L;i++)
+          A[b*ld+a] += PetscConj(W[a*L+i])*HW[b*L+i];
+        A[b*ld+a] /= sigma[order[a]]*sigma[order[b]];
+      }
+    DSRestoreArray(c->ds[1],DS_MAT_A,&A);
+    DSSetState(c->ds[1],DS_STATE_RAW);
+    DSSolve(c->ds[1],eig,eigi);
+    DSVectors(c->ds[1],DS_MAT_X,NULL,NULL);
+    DSGetArray(c->ds[1],DS_MAT_X,&X);
+    for(a=0;a<k;a++)
+    {
+      mu = eig[a];
+      if( !isfinite(cabs(TO_DOUBLE_COMPLEX(mu))) || PetscAbsScalar(mu)>1+CONTOUR_EDGE )
+        continue;
+      lambda = center+radius*TO_DOUBLE_COMPLEX(mu);
+      if( c->rectangle && ( creal(lambda/scale)<creal(c->lower) || creal(lambda/scale)>creal(c->upper) ||
+                            cimag(lambda/scale)<cimag(c->lower) || cimag(lambda/scale)>cimag(c->upper) ) )
+        continue;
+
+      // u = M0 W S^-1 s
+      for(i=0;i<L;i++)
+      {
+        y[i] = 0;
+        for(b=0;b<k;b++)
+          y[i] += W[b*L+i]*X[a*ld+b]/sigma[order[b]];
+      }
+      VecSet(c->U[c->nfound],0);
+      VecMAXPY(c->U[c->nfound],L,y,c->M0);
+      VecNormalize(c->U[c->nfound],NULL);
+      residual = relativeResidual(c,K,D,E,TO_PETSC_COMPLEX(lambda),c->U[c->nfound]);
+      if( residual>c->tol )
+        continue;
+      if( residual>c->worst )
+        c->worst = residual;
+      c->lambda[c->nfound++] = TO_PETSC_COMPLEX(lambda);
+    }
+    DSRestoreArray(c->ds[1],DS_MAT_X,&X);
+  }
+
+  // Increasing real part
+  for(j=1;j<c->nfound;j++)
+    for(i=j;i>0 && PetscRealPart(c->lambda[i])<PetscRealPart(c->lambda[i-1]);i--)
+    {
+      swap = c->lambda[i];
+      c->lambda[i] = c->lambda[i-1];
+      c->lambda[i-1] = swap;
+      tmp = c->U[i];
+      c->U[i] = c->U[i-1];
+      c->U[i-1] = tmp;
+    }
+  grvy_timer_end("contour");
+  return c->nfound;
+}
+
+void getContourEigenpair(ContourSolver *c, int k, PetscScalar *lambda, Vec U)
+{
+  *lambda = c->lambda[k];
+  VecCopy(c->U[k],U);
+}
+
+void deleteContourSolver(ContourSolver *c)
+{
+  if( c->setup )
+  {
+    MatDestroy(&(c->Ks));
+    MatDestroy(&(c->Ds));
+    MatDestroy(&(c->Es));
+    MatDestroy(&(c->T));
+    KSPDestroy(&(c->ksp));
+    VecDestroy(&(c->x));
+    VecDestroyVecs(c->columns,&(c->probe));
+    VecDestroyVecs(c->columns,&(c->A0));
+    VecDestroyVecs(c->columns,&(c->A1));
+    VecDestroyVecs(c->columns,&(c->M0));
+    VecDestroyVecs(c->columns,&(c->M1));
+    VecDestroyVecs(c->columns,&(c->U));
+    VecDestroy(&(c->w[0]));
+    VecDestroy(&(c->w[1]));
+    VecDestroy(&(c->w[2]));
+    VecDestroy(&(c->view));
+    VecScatterDestroy(&(c->gather));
+    DSDestroy(&(c->ds[0]));
+    DSDestroy(&(c->ds[1]));
+    MPI_Comm_free(&(c->across));
+  }
+  free(c->lambda);
+  free(c);
+}
@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Contour-integral (Beyn) solver for all eigenvalues inside a region, with
+// the quadrature nodes factored concurrently on subcommunicators
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_CONTOUR
+#define QEPPS_CONTOUR
+
+typedef struct
+{
+  double complex center;   // Circle the quadrature runs on (unscaled eigenvalues)
+  double radius;
+  bool rectangle;          // Only eigenvalues inside [lower, upper] are kept
+  double complex lower, upper;
+  int nodes;               // Trapezoidal quadrature nodes on the circle
+  int columns;             // Probing vectors, the most eigenvalues one solve can find
+  int groups;              // Subcommunicators the nodes are distributed over
+  double tol;              // Relative residual an eigenpair is accepted with
+  bool setup;
+  MPI_Comm subcomm;        // Ranks factoring the same nodes
+  MPI_Comm across;         // Ranks at the same position of every subcommunicator
+  int group;               // Subcommunicator of this rank
+  Mat Ks, Ds, Es, T;       // Operators and the shifted matrix on the subcommunicator
+  KSP ksp;
+  Vec *probe, *A0, *A1;    // Probing vectors and moments in the subcommunicator layout
+  Vec *M0, *M1;            // Moments in the layout of the operators
+  Vec x, w[3];
+  Vec view;                // Operator-layout view of the first subcommunicator's vectors
+  VecScatter gather;
+  DS ds[2];                // Dense solvers of the Gram matrix (hep) and the reduced pencil (nhep)
+  int count;               // Eigenvalues estimated inside the circle (rank of the moments)
+  int nfound;              // Eigenpairs extracted and accepted
+  PetscScalar *lambda;     // Their eigenvalues (of the scaled problem)
+  Vec *U;                  // Their eigenvectors
+  PetscReal worst;         // Largest relative residual among them
+  bool saturated;          // The count reached the number of probing vectors
+} ContourSolver;
+
+/*!
+ *  Reads the region from the QEPPS options table in the LUA state: a circle (contour_center,
+ *  contour_radius) or a rectangle (contour_lower, contour_upper corners), which is integrated
+ *  over its circumscribed circle. Returns NULL when neither is set. contour_nodes,
+ *  contour_columns, contour_groups, and contour_tolerance tune the solve. The linear solver of
+ *  the nodes takes the contour_ options prefix (lu, or cholesky for symmetric storage, with mumps on
+ *  subcommunicators of more than one rank).
+ */
+ContourSolver *createContourSolver(void);
+
+/*!
+ *  Finds the eigenvalues of K + mu*D + mu^2*E inside the region, where mu = scale*lambda is
+ *  the scaled eigenvalue of the unscaled region. Every subcommunicator factors its share of
+ *  the nodes and solves for all probing vectors, the moments are summed across them. The
+ *  numerical rank of the zeroth moment estimates the count before extraction. Returns the
+ *  number of eigenpairs accepted by their residual.
+ */
+int solveContour(ContourSolver *c, Mat K, Mat D, Mat E, double complex scale);
+
+/*!
+ *  Returns eigenpair k of the last solve
+ */
+void getContourEigenpair(ContourSolver *c, int k, PetscScalar *lambda, Vec U);
+
+void deleteContourSolver(ContourSolver *c);
+
+#endif
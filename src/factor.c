@@ -0,0 +1,327 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Direct factorization of the shifted matrix K + sigma*D + sigma^2*E with
+// the ordering and symbolic analysis done once for the whole sweep
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include <grvy.h>
+#include "types.h"
+#include "assemble.h"
+#include "lowrank.h"
+#include "condense.h"
+#include "factor.h"
+#include "log.h"
+
+ShiftedFactor *createShiftedFactor(Mat K, Mat D, Mat E, bool padded, bool cholesky, const char *package)
+{
+  AssemblyOptions opts = {false,false,false,false,0,1};
+
+  ShiftedFactor *f = malloc( sizeof(ShiftedFactor) );
+  if (f==NULL)
+    logError("#! Allocation of the shifted factorization failed\n");
+  f->K = K;
+  f->D = D;
+  f->E = E;
+  f->cholesky = cholesky;
+  PetscStrncpy(f->package,package,sizeof(f->package));
+  f->F = NULL;
+  f->sigma = 0;
+  f->analyses = f->factorizations = 0;
+  f->stale = false;
+  f->relaxed = false;
+  f->lowrank = NULL;
+  f->updated = false;
+  f->condensed = NULL;
+  f->max_its = 0;
+  f->reuses = 0;
+  f->rtol = 0;
+  resetFactorStats(f);
+  f->Mc = NULL;
+  f->Pa = NULL;
+
+  if(padded) {
+    // Same pattern for all three, P(sigma) is two axpys away from K
+    MatDuplicate(K,MAT_DO_NOT_COPY_VALUES,&(f->P));
+  } else {
+    f->Mc = malloc( MATRIX_COMPONENT_SIZE(3) );
+    if (f->Mc==NULL)
+      logError("#! Allocation of the shifted factorization failed\n");
+    f->Mc->num = 3;
+    f->Mc->symmetric = false;
+    f->Mc->matrix[0] = K;
+    f->Mc->matrix[1] = D;
+    f->Mc->matrix[2] = E;
+    f->Pa = createAssembler("P",f->Mc,&opts);
+    f->P = f->Pa->M;
+  }
+  return f;
+}
+
+// mumps controls of the relaxed factor: CNTL(1) = 0 turns off threshold pivoting, CNTL(4) = 0
+// turns on static pivoting with the threshold chosen by mumps. They are only in the options
+// database while the analysis reads them, what was there before (the command line) is put back.
+static const char *relaxed_options[2][2] = {{"-mat_mumps_cntl_1","0.0"},{"-mat_mumps_cntl_4","0.0"}};
+
+static void pushRelaxedOptions(char saved[2][64], PetscBool set[2])
+{
+  int i;
+  for(i=0;i<2;i++)
+  {
+    PetscOptionsGetString(NULL,relaxed_options[i][0],saved[i],64,&set[i]);
+    PetscOptionsSetValue(relaxed_options[i][0],relaxed_options[i][1]);
+  }
+}
+
+static void popRelaxedOptions(char saved[2][64], const PetscBool set[2])
+{
+  int i;
+  for(i=0;i<2;i++)
+  {
+    if(set[i])
+      PetscOptionsSetValue(relaxed_options[i][0],saved[i]);
+    else
+      PetscOptionsClearValue(relaxed_options[i][0]);
+  }
+}
+
+static void assembleShifted(ShiftedFactor *f, PetscScalar sigma)
+{
+  PetscScalar c[3] = {1,sigma,sigma*sigma};
+
+  if(f->Pa) {
+    combineComponents(f->Pa,c);
+    return;
+  }
+  MatCopy(f->K,f->P,SAME_NONZERO_PATTERN);
+  MatAXPY(f->P,c[1],f->D,SAME_NONZERO_PATTERN);
+  MatAXPY(f->P,c[2],f->E,SAME_NONZERO_PATTERN);
+}
+
+void factorShifted(ShiftedFactor *f, PetscScalar sigma)
+{
+  MatFactorInfo info;
+  IS row=NULL, col=NULL;
+  char saved[2][64];
+  PetscBool set[2];
+
+  assembleShifted(f,sigma);
+  f->updated = false;
+  if(f->condensed!=NULL) {
+    factorCondensed(f->condensed,f->P,sigma,f->package);
+    f->analyses = f->condensed->analyses;
+    f->factorizations = f->condensed->factorizations;
+    f->sigma = sigma;
+    return;
+  }
+  if(f->lowrank!=NULL && f->F!=NULL && sigma==f->sigma) {
+    // Only part of P changed at the same shift, the factor may stay
+    grvy_timer_begin("factor");
+    f->updated = updateLowRank(f->lowrank,f->P,f->F,f->cholesky);
+    grvy_timer_end("factor");
+    if(f->updated)
+      return;
+  }
+  MatFactorInfoInitialize(&info);
+  if(f->F==NULL) {
+    // The pattern of P never changes, so this is the only ordering and symbolic factorization
+    grvy_timer_begin("analysis");
+    MatGetFactor(f->P,f->package,f->cholesky ? MAT_FACTOR_CHOLESKY : MAT_FACTOR_LU,&(f->F));
+    if(f->F==NULL)
+      logError("#! Solver package '%s' can not factor the shifted matrix\n",f->package);
+    // External packages order internally, PETSc's own factorization needs it done here (its
+    // SBAIJ cholesky only takes the natural ordering)
+    if(strcmp(f->package,MATSOLVERPETSC)==0)
+      MatGetOrdering(f->P,f->cholesky ? MATORDERINGNATURAL : MATORDERINGND,&row,&col);
+    if(f->relaxed)
+      pushRelaxedOptions(saved,set);
+    if(f->cholesky)
+      MatCholeskyFactorSymbolic(f->F,f->P,row,&info);
+    else
+      MatLUFactorSymbolic(f->F,f->P,row,col,&info);
+    if(f->relaxed)
+      popRelaxedOptions(saved,set);
+    ISDestroy(&row);
+    ISDestroy(&col);
+    f->analyses++;
+    grvy_timer_end("analysis");
+  }
+
+  grvy_timer_begin("factor");
+  if(f->cholesky)
+    MatCholeskyFactorNumeric(f->F,f->P,&info);
+  else
+    MatLUFactorNumeric(f->F,f->P,&info);
+  f->sigma = sigma;
+  f->factorizations++;
+  if(f->lowrank!=NULL)
+    setLowRankBase(f->lowrank,f->P);
+  grvy_timer_end("factor");
+}
+
+void setLowRankUpdates(ShiftedFactor *f, int max_rank)
+{
+  f->lowrank = createLowRankUpdate(f->P,max_rank);
+}
+
+bool setCondensation(ShiftedFactor *f, Vec mark, int max_size)
+{
+  f->condensed = createCondensedFactor(f->P,mark,max_size);
+  return f->condensed!=NULL;
+}
+
+void solveShifted(ShiftedFactor *f, Vec x, Vec y)
+{
+  if(f->condensed!=NULL)
+    applyCondensed(f->condensed,x,y);
+  else if(f->lowrank!=NULL)
+    applyLowRank(f->lowrank,f->F,x,y);
+  else
+    MatSolve(f->F,x,y);
+}
+
+static PetscErrorCode applyShiftedFactor(PC pc, Vec x, Vec y)
+{
+  ShiftedFactor *f;
+
+  PCShellGetContext(pc,(void**)&f);
+  solveShifted(f,x,y);
+  return 0;
+}
+
+void attachShiftedFactor(ShiftedFactor *f, ST st)
+{
+  KSP ksp;
+  PC pc;
+
+  STSetMatMode(st,ST_MATMODE_SHELL);
+  STGetKSP(st,&ksp);
+  KSPSetType(ksp,KSPPREONLY);
+  KSPGetPC(ksp,&pc);
+  PCSetType(pc,PCSHELL);
+  PCShellSetContext(pc,f);
+  PCShellSetApply(pc,applyShiftedFactor);
+  PCShellSetName(pc,"shifted factor");
+}
+
+// Counts inner solves (iteration 0) and iterations, and keeps the relative residual of the
+// current solve
+static PetscErrorCode monitorShiftedFactor(KSP ksp, PetscInt it, PetscReal rnorm, void *ctx)
+{
+  ShiftedFactor *f = (ShiftedFactor*)ctx;
+  (void)ksp;
+
+  if(it==0) {
+    innerSolveFailed(f);
+    f->solves++;
+    f->rnorm0 = rnorm;
+  } else {
+    f->its++;
+  }
+  f->rnorm = rnorm;
+  return 0;
+}
+
+// Makes the factor the preconditioner of a monitored GMRES inner solve
+static void correctWithFactor(ShiftedFactor *f, ST st, int max_its)
+{
+  KSP ksp;
+
+  if(f->stale || f->relaxed)
+    return;
+  f->max_its = max_its;
+  STGetKSP(st,&ksp);
+  KSPSetType(ksp,KSPGMRES);
+  KSPGetTolerances(ksp,&(f->rtol),NULL,NULL,NULL);
+  KSPMonitorSet(ksp,monitorShiftedFactor,f,NULL);
+}
+
+void setStaleFactor(ShiftedFactor *f, ST st, int max_its)
+{
+  correctWithFactor(f,st,max_its);
+  f->stale = true;
+}
+
+bool setRelaxedFactor(ShiftedFactor *f, ST st, int max_its)
+{
+  if(strcmp(f->package,MATSOLVERMUMPS)!=0)
+    return false;
+  // The controls are set for the analysis in factorShifted()
+  correctWithFactor(f,st,max_its);
+  f->relaxed = true;
+  return true;
+}
+
+bool relaxedFactorStalled(ShiftedFactor *f)
+{
+  return f->relaxed && (innerSolveFailed(f) || innerIterations(f) > f->max_its);
+}
+
+void restoreExactFactor(ShiftedFactor *f, ST st)
+{
+  KSP ksp;
+
+  if(!f->relaxed)
+    return;
+  // A new analysis reads the controls of the command line (or the mumps defaults)
+  MatDestroy(&(f->F));
+  f->relaxed = false;
+  if(!f->stale) {
+    STGetKSP(st,&ksp);
+    KSPMonitorCancel(ksp);
+    KSPSetType(ksp,KSPPREONLY);
+  }
+}
+
+void resetFactorStats(ShiftedFactor *f)
+{
+  f->solves = f->its = 0;
+  f->rnorm0 = f->rnorm = f->worst = 0;
+}
+
+double innerIterations(ShiftedFactor *f)
+{
+  return f->solves>0 ? (double)f->its/f->solves : 0;
+}
+
+bool innerSolveFailed(ShiftedFactor *f)
+{
+  // Fold in the solve still being monitored
+  if(f->rnorm0>0 && f->rnorm/f->rnorm0 > f->worst)
+    f->worst = f->rnorm/f->rnorm0;
+  return f->worst > f->rtol;
+}
+
+bool staleFactorExpired(ShiftedFactor *f)
+{
+  if(f->F==NULL)
+    return true;
+  return innerSolveFailed(f) || innerIterations(f) > f->max_its;
+}
+
+void deleteShiftedFactor(ShiftedFactor *f)
+{
+  MatDestroy(&(f->F));
+  if(f->lowrank!=NULL)
+    deleteLowRankUpdate(f->lowrank);
+  if(f->condensed!=NULL)
+    deleteCondensedFactor(f->condensed);
+  if(f->Pa) {
+    deleteAssembler(f->Pa);
+    free(f->Mc);
+  } else {
+    MatDestroy(&(f->P));
+  }
+  free(f);
+}
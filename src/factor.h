@@ -0,0 +1,141 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Direct factorization of the shifted matrix K + sigma*D + sigma^2*E with
+// the ordering and symbolic analysis done once for the whole sweep
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_FACTOR
+#define QEPPS_FACTOR
+
+typedef struct
+{
+  Mat K, D, E;             // Total matricies, owned by their assemblers
+  Mat P;                   // P(sigma) = K + sigma*D + sigma^2*E
+  MatrixComponent *Mc;     // K, D, and E as the components of P (general storage)
+  MatrixAssembler *Pa;     // Assembler of P on the union pattern of K, D, and E, NULL when padded
+  bool cholesky;           // P is MATSBAIJ and factored as LDL^T
+  char package[64];        // Solver package of the factorization
+  Mat F;                   // Factor of P
+  PetscScalar sigma;       // Shift F was computed for
+  int analyses;            // Ordering and symbolic factorizations done
+  int factorizations;      // Numeric factorizations done
+  bool stale;              // The factor preconditions a GMRES inner solve instead of being applied once
+  bool relaxed;            // The factor is computed with static pivoting, GMRES corrects the solves
+  int max_its;             // Inner iterations per solve beyond which the factor is renewed (or made exact)
+  int reuses;              // Parameters solved with a factor from an earlier parameter
+  int solves, its;         // Inner solves and iterations since resetFactorStats()
+  PetscReal rnorm0, rnorm; // First and latest residual norm of the current inner solve
+  PetscReal worst;         // Largest relative residual an inner solve ended with
+  PetscReal rtol;          // Relative tolerance of the inner solve
+  LowRankUpdate *lowrank;  // Woodbury updates of the factor at an unchanged shift, NULL for none
+  bool updated;            // The last factorShifted() was a low-rank update
+  CondensedFactor *condensed; // Schur complement onto the parameter-dependent rows, NULL for none
+} ShiftedFactor;
+
+/*!
+ *  Sets up P(sigma) for the total matricies K, D, and E. With padded storage (all three on one
+ *  shared pattern, see createPaddedAssembler()) P is a copy of K, otherwise it is assembled on
+ *  the union pattern of the three. The factorization uses package, LDL^T when cholesky is set.
+ */
+ShiftedFactor *createShiftedFactor(Mat K, Mat D, Mat E, bool padded, bool cholesky, const char *package);
+
+/*!
+ *  Assembles P(sigma) from the current K, D, and E and factors it. The ordering and symbolic
+ *  factorization (timer "analysis") are only done on the first call, every call does the
+ *  numeric factorization (timer "factor") unless a low-rank update at the same shift does. A
+ *  condensed factor only refactors the Schur complement at the same shift.
+ */
+void factorShifted(ShiftedFactor *f, PetscScalar sigma);
+
+/*!
+ *  Keeps the factor at an unchanged shift when the change of P since the factorization touches
+ *  at most max_rank rows (and columns), which a Woodbury update then takes (see lowrank.h).
+ */
+void setLowRankUpdates(ShiftedFactor *f, int max_rank);
+
+/*!
+ *  Condenses P onto the interface rows where mark is nonzero (see markVaryingRows()): their
+ *  complement is factored only when the shift changes, each factorShifted() then factors the
+ *  dense Schur complement of the interface alone (see condense.h). Returns false, leaving the
+ *  factor as it is, when the interface is empty or has more than max_size rows. Needs general
+ *  (AIJ) storage, call before the first factorShifted().
+ */
+bool setCondensation(ShiftedFactor *f, Vec mark, int max_size);
+
+/*!
+ *  y = P(sigma)^-1 x with the factor and its low-rank update, or by the condensed factor
+ */
+void solveShifted(ShiftedFactor *f, Vec x, Vec y);
+
+/*!
+ *  Makes the spectral transformation st apply the factor of f: its matrix is left as a shell
+ *  (never formed by SLEPc) and its KSP is a preonly PCSHELL calling MatSolve().
+ */
+void attachShiftedFactor(ShiftedFactor *f, ST st);
+
+/*!
+ *  Keeps the factor of an earlier shift as the preconditioner of a GMRES inner solve (call
+ *  after attachShiftedFactor()). staleFactorExpired() tells when it should be renewed.
+ */
+void setStaleFactor(ShiftedFactor *f, ST st, int max_its);
+
+/*!
+ *  Computes the factor at reduced accuracy (mumps only, returns false for other packages): no
+ *  threshold pivoting, so the pivot order of the analysis is kept and no pivots are delayed,
+ *  and static pivoting replaces tiny pivots by about sqrt(eps)|P|. The solves become GMRES
+ *  preconditioned by the factor, which corrects them to the tolerance of the inner solve. Call
+ *  after attachShiftedFactor() and before the first factorShifted().
+ */
+bool setRelaxedFactor(ShiftedFactor *f, ST st, int max_its);
+
+/*!
+ *  Returns true if the relaxed factor took more than max_its inner iterations per solve or
+ *  failed to reach the tolerance since resetFactorStats().
+ */
+bool relaxedFactorStalled(ShiftedFactor *f);
+
+/*!
+ *  Goes back to the exact factor (threshold pivoting) for the rest of the sweep. The analysis
+ *  is redone by the next factorShifted(), the solves are applied once unless the factor is
+ *  stale.
+ */
+void restoreExactFactor(ShiftedFactor *f, ST st);
+
+/*!
+ *  Clears the inner solve statistics gathered by the KSP monitor.
+ */
+void resetFactorStats(ShiftedFactor *f);
+
+/*!
+ *  Returns the mean number of inner iterations per solve since resetFactorStats().
+ */
+double innerIterations(ShiftedFactor *f);
+
+/*!
+ *  Returns true if an inner solve since resetFactorStats() stopped above the relative tolerance.
+ */
+bool innerSolveFailed(ShiftedFactor *f);
+
+/*!
+ *  Returns true if there is no factor yet, or the stale factor took more than max_its inner
+ *  iterations per solve or failed to reach the tolerance since resetFactorStats().
+ */
+bool staleFactorExpired(ShiftedFactor *f);
+
+/*!
+ *  Frees P, the factor, and the assembler of P. K, D, and E are left to their assemblers.
+ */
+void deleteShiftedFactor(ShiftedFactor *f);
+
+#endif
@@ -0,0 +1,226 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Parameter farm: groups of ranks solving different chunks of the
+// parameter sweep concurrently
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "config.h"
+#include "farm.h"
+#include "slice.h"
+#include "log.h"
+
+// Tag of the held back output sent to the first rank
+#define FARM_TAG 7101
+
+// Chunks per group when the chunk size is not set, small enough to balance the load and large
+// enough for the warm starts along a chunk to pay off
+#define CHUNKS_PER_GROUP 4
+
+// Set by splitWorld(), before PETSc and the options are available
+static int split_groups=1, split_group=0;
+
+MPI_Comm splitWorld(int ranks_per_group)
+{
+  int rank, size;
+  MPI_Comm group;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  if(ranks_per_group<=0 || ranks_per_group>=size)
+    return MPI_COMM_WORLD;
+  split_groups = (size+ranks_per_group-1)/ranks_per_group;
+  split_group = rank/ranks_per_group;
+  MPI_Comm_split(MPI_COMM_WORLD,split_group,rank,&group);
+  return group;
+}
+
+ParameterFarm *createParameterFarm(void)
+{
+  int n=getNumberOfParameters(), rank, size;
+
+  ParameterFarm *farm = malloc( sizeof(ParameterFarm) );
+  if (farm==NULL)
+    logError("#! Allocation of the parameter farm failed\n");
+  farm->groups = split_groups;
+  farm->group = split_group;
+  farm->split = split_groups>1 && getSliceCount()==1;
+  MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  farm->root = rank==0;
+  farm->end = 0;
+  farm->next = 0;
+  farm->counter = 0;
+  farm->text = NULL;
+
+  if(!farm->split) {
+    farm->chunk = n>0 ? n : 1;
+    return farm;
+  }
+  farm->chunk = getOptIntLUA("parameter_chunk",0);
+  if(farm->chunk<=0)
+    farm->chunk = n/(CHUNKS_PER_GROUP*farm->groups);
+  if(farm->chunk<=0)
+    farm->chunk = 1;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Win_create(&(farm->counter),rank==0 ? sizeof(int) : 0,sizeof(int),MPI_INFO_NULL,MPI_COMM_WORLD,&(farm->win));
+  if(farm->root) {
+    farm->text = calloc( n>0 ? n : 1, sizeof(char*) );
+    if (farm->text==NULL)
+      logError("#! Allocation of the parameter farm output failed\n");
+  }
+  MPI_Comm_size(PETSC_COMM_WORLD,&size);
+  logOutput("# parameter farm: %i groups (%i ranks in the first), chunks of %i parameters\n",
+            farm->groups,size,farm->chunk);
+  return farm;
+}
+
+int nextParameter(ParameterFarm *farm, int p)
+{
+  int c=0, one=1, start, n=getNumberOfParameters();
+
+  if(p>=0 && p+1<farm->end)
+    return p+1;
+
+  if(!farm->split) {
+    c = farm->next++;
+  } else {
+    if(farm->root) {
+      MPI_Win_lock(MPI_LOCK_SHARED,0,0,farm->win);
+      MPI_Fetch_and_op(&one,&c,MPI_INT,0,0,MPI_SUM,farm->win);
+      MPI_Win_unlock(0,farm->win);
+    }
+    MPI_Bcast(&c,1,MPI_INT,0,PETSC_COMM_WORLD);
+  }
+  start = c*farm->chunk;
+  if(start>=n)
+    return -1;
+  farm->end = start+farm->chunk < n ? start+farm->chunk : n;
+  return start;
+}
+
+void beginParameter(ParameterFarm *farm)
+{
+  if(farm->split)
+    logBufferBegin();
+}
+
+void endParameter(ParameterFarm *farm, int p)
+{
+  char *text;
+
+  if(!farm->split)
+    return;
+  text = logBufferEnd();
+  if(farm->root) {
+    free(farm->text[p]);
+    farm->text[p] = text;
+  }
+}
+
+// Records of (parameter index, length, text) behind the group index
+static char *packOutput(ParameterFarm *farm, int *len)
+{
+  int p, l, n=getNumberOfParameters(), pos=0;
+  char *msg;
+
+  *len = sizeof(int);
+  for(p=0;p<n;p++)
+    if(farm->text[p]!=NULL)
+      *len += 2*sizeof(int)+strlen(farm->text[p])+1;
+  msg = malloc(*len);
+  if (msg==NULL)
+    logError("#! Allocation of the parameter farm output failed\n");
+  memcpy(msg,&(farm->group),sizeof(int)); pos += sizeof(int);
+  for(p=0;p<n;p++)
+  {
+    if(farm->text[p]==NULL)
+      continue;
+    l = strlen(farm->text[p])+1;
+    memcpy(msg+pos,&p,sizeof(int)); pos += sizeof(int);
+    memcpy(msg+pos,&l,sizeof(int)); pos += sizeof(int);
+    memcpy(msg+pos,farm->text[p],l); pos += l;
+  }
+  return msg;
+}
+
+// Returns the number of parameters in msg
+static int unpackOutput(ParameterFarm *farm, const char *msg, int len)
+{
+  int p, l, count=0, pos=sizeof(int);
+
+  while(pos<len)
+  {
+    memcpy(&p,msg+pos,sizeof(int)); pos += sizeof(int);
+    memcpy(&l,msg+pos,sizeof(int)); pos += sizeof(int);
+    free(farm->text[p]);
+    farm->text[p] = malloc(l);
+    if (farm->text[p]==NULL)
+      logError("#! Allocation of the parameter farm output failed\n");
+    memcpy(farm->text[p],msg+pos,l); pos += l;
+    count++;
+  }
+  return count;
+}
+
+void mergeParameterFarm(ParameterFarm *farm)
+{
+  int rank, g, group, len, p, n=getNumberOfParameters();
+  int solved[farm->groups];
+  char *msg;
+  MPI_Status status;
+
+  if(!farm->split)
+    return;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  if(farm->root && rank!=0) {
+    msg = packOutput(farm,&len);
+    MPI_Send(msg,len,MPI_CHAR,0,FARM_TAG,MPI_COMM_WORLD);
+    free(msg);
+  } else if(rank==0) {
+    solved[0] = 0;
+    for(p=0;p<n;p++)
+      if(farm->text[p]!=NULL) solved[0]++;
+    for(g=1;g<farm->groups;g++)
+    {
+      MPI_Probe(MPI_ANY_SOURCE,FARM_TAG,MPI_COMM_WORLD,&status);
+      MPI_Get_count(&status,MPI_CHAR,&len);
+      msg = malloc(len);
+      if (msg==NULL)
+        logError("#! Allocation of the parameter farm output failed\n");
+      MPI_Recv(msg,len,MPI_CHAR,status.MPI_SOURCE,FARM_TAG,MPI_COMM_WORLD,MPI_STATUS_IGNORE);
+      memcpy(&group,msg,sizeof(int));
+      solved[group] = unpackOutput(farm,msg,len);
+      free(msg);
+    }
+    for(p=0;p<n;p++)
+      logWrite(farm->text[p]);
+    for(g=0;g<farm->groups;g++)
+      logOutput("# parameter farm: group %i solved %i parameters\n",g,solved[g]);
+  }
+}
+
+void deleteParameterFarm(ParameterFarm *farm)
+{
+  int p;
+
+  if(farm->split)
+    MPI_Win_free(&(farm->win));
+  if(farm->text!=NULL) {
+    for(p=0;p<getNumberOfParameters();p++)
+      free(farm->text[p]);
+    free(farm->text);
+  }
+  free(farm);
+}
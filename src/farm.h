@@ -0,0 +1,72 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Parameter farm: groups of ranks solving different chunks of the
+// parameter sweep concurrently
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_FARM
+#define QEPPS_FARM
+
+typedef struct
+{
+  int groups;              // Number of rank groups, 1 when the sweep is not split
+  int group;               // Group of this rank
+  bool split;              // Groups solve different parameters (all of them when slicing the spectrum)
+  bool root;               // First rank of its group
+  int chunk;               // Parameters taken at a time
+  int end;                 // End of the current chunk
+  int next;                // Next chunk when not split
+  MPI_Win win;             // Chunk counter, hosted on the first rank of MPI_COMM_WORLD
+  int counter;
+  char **text;             // Output of every parameter solved by this group (group roots only)
+} ParameterFarm;
+
+/*!
+ *  Splits MPI_COMM_WORLD into groups of ranks_per_group consecutive ranks and returns the
+ *  group of the calling rank, to become PETSC_COMM_WORLD. Must be called after MPI_Init() and
+ *  before SlepcInitialize(). Returns MPI_COMM_WORLD when ranks_per_group is not positive or
+ *  covers all ranks.
+ */
+MPI_Comm splitWorld(int ranks_per_group);
+
+/*!
+ *  Sets up the chunk scheduling, with the chunk size from the QEPPS options table in the LUA
+ *  state. When the groups are slices of the spectrum, every group walks all parameters in
+ *  order instead. Collective over MPI_COMM_WORLD.
+ */
+ParameterFarm *createParameterFarm(void);
+
+/*!
+ *  Returns the parameter index to solve after p (pass -1 for the first), or -1 when the sweep
+ *  is done. Indices run contiguously within a chunk, a new chunk is taken from the shared
+ *  counter by whichever group gets there first. Collective over PETSC_COMM_WORLD.
+ */
+int nextParameter(ParameterFarm *farm, int p);
+
+/*!
+ *  Bracket the output of one parameter. With more than one group it is held back until
+ *  mergeParameterFarm().
+ */
+void beginParameter(ParameterFarm *farm);
+void endParameter(ParameterFarm *farm, int p);
+
+/*!
+ *  Collects the held back output of all groups on the first rank of MPI_COMM_WORLD and writes
+ *  it in parameter order. Collective over MPI_COMM_WORLD.
+ */
+void mergeParameterFarm(ParameterFarm *farm);
+
+void deleteParameterFarm(ParameterFarm *farm);
+
+#endif
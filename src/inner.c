@@ -0,0 +1,330 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Iterative inner solver of the spectral transformation (GMRES or BiCGStab
+// with ASM, GAMG, or Jacobi) for shifted matricies too large to factor
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include "types.h"
+#include "config.h"
+#include "assemble.h"
+#include "inner.h"
+#include "log.h"
+
+// Work vectors of BiCGStab, and the fill of a GAMG hierarchy (with its smoothers) relative to
+// the fine matrix
+#define BCGS_VECTORS 7
+#define GAMG_FILL 1.5
+
+// Relaxes the inner tolerance as the outer residual goes down: the error of an inexact
+// application of the operator may grow like the inverse of the residual
+static PetscErrorCode relaxInnerTolerance(PEP pep, PetscInt its, PetscInt nconv, PetscScalar *eigr, PetscScalar *eigi, PetscReal *errest, PetscInt nest, void *ctx)
+{
+  InnerSolver *s = (InnerSolver*)ctx;
+  PetscReal rtol = s->rtol;
+  (void)pep; (void)its; (void)eigr; (void)eigi;
+
+  if(nconv<nest && errest[nconv]>0 && errest[nconv]<1)
+    rtol = s->rtol/errest[nconv];
+  if(rtol>s->rtol_max)
+    rtol = s->rtol_max;
+  if(rtol>s->rtol_used)
+    s->rtol_used = rtol;
+  KSPSetTolerances(s->ksp,rtol,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT);
+  return 0;
+}
+
+// Counts inner solves (iteration 0) and iterations
+static PetscErrorCode monitorInnerSolver(KSP ksp, PetscInt it, PetscReal rnorm, void *ctx)
+{
+  InnerSolver *s = (InnerSolver*)ctx;
+  (void)ksp; (void)rnorm;
+
+  if(it==0)
+    s->solves++;
+  else
+    s->its++;
+  return 0;
+}
+
+// Smallest part of a vector's image outside the recycle space that extends it
+#define RECYCLE_DROP_TOL 1e-8
+
+// Appends U[k] to the recycle space: its image is orthogonalized against C (U follows along)
+// and dropped when (nearly) inside
+static void extendRecycleSpace(InnerSolver *s)
+{
+  int k=s->nrecycled, i;
+  PetscReal norm0, norm;
+
+  MatMult(s->A,s->U[k],s->C[k]);
+  VecNorm(s->C[k],NORM_2,&norm0);
+  if(k>0) {
+    VecMDot(s->C[k],k,s->C,s->h);
+    for(i=0;i<k;i++)
+      s->h[i] = -s->h[i];
+    VecMAXPY(s->C[k],k,s->h,s->C);
+    VecMAXPY(s->U[k],k,s->h,s->U);
+  }
+  VecNorm(s->C[k],NORM_2,&norm);
+  if(norm0==0 || norm<=RECYCLE_DROP_TOL*norm0)
+    return;
+  VecScale(s->C[k],1/norm);
+  VecScale(s->U[k],1/norm);
+  s->nrecycled++;
+}
+
+// Setup of the shell preconditioner, once per shifted matrix: sets up the wrapped one and
+// rebuilds the recycle space from the newest solutions
+static PetscErrorCode setupRecycled(PC pc)
+{
+  InnerSolver *s;
+  Mat A, P;
+  int i;
+
+  PCShellGetContext(pc,(void**)&s);
+  PCGetOperators(pc,&A,&P);
+  PCSetOperators(s->base,A,P);
+  PCSetUp(s->base);
+  s->A = A;
+  if(s->t==NULL) {
+    MatGetVecs(A,&(s->t),NULL);
+    VecDuplicateVecs(s->t,s->recycle,&(s->X));
+    VecDuplicateVecs(s->t,s->recycle,&(s->U));
+    VecDuplicateVecs(s->t,s->recycle,&(s->C));
+  }
+  s->nrecycled = 0;
+  for(i=0;i<s->nx;i++)
+  {
+    VecCopy(s->X[(s->next+s->recycle-1-i)%s->recycle],s->U[s->nrecycled]);
+    extendRecycleSpace(s);
+  }
+  return 0;
+}
+
+// y = U C^H r + M^-1 (r - C C^H r)
+static PetscErrorCode applyRecycled(PC pc, Vec r, Vec y)
+{
+  InnerSolver *s;
+  int i, k;
+
+  PCShellGetContext(pc,(void**)&s);
+  k = s->nrecycled;
+  if(k==0)
+    return PCApply(s->base,r,y);
+  VecMDot(r,k,s->C,s->h);
+  VecCopy(r,s->t);
+  for(i=0;i<k;i++)
+    s->h[i] = -s->h[i];
+  VecMAXPY(s->t,k,s->h,s->C);
+  PCApply(s->base,s->t,y);
+  for(i=0;i<k;i++)
+    s->h[i] = -s->h[i];
+  VecMAXPY(y,k,s->h,s->U);
+  return 0;
+}
+
+// Keeps the solution of every inner solve, extending the recycle space until it is full
+static PetscErrorCode recordSolution(KSP ksp, Vec b, Vec x, void *ctx)
+{
+  InnerSolver *s = (InnerSolver*)ctx;
+  (void)ksp; (void)b;
+
+  VecCopy(x,s->X[s->next]);
+  VecNormalize(s->X[s->next],NULL);
+  if(s->nrecycled<s->recycle) {
+    VecCopy(s->X[s->next],s->U[s->nrecycled]);
+    extendRecycleSpace(s);
+  }
+  s->next = (s->next+1)%s->recycle;
+  if(s->nx<s->recycle)
+    s->nx++;
+  return 0;
+}
+
+bool innerFieldBlocks(void)
+{
+  char *type = getOptStringLUA("inner_solver","");
+  char *pc_type = getOptStringLUA("inner_pc","asm");
+  bool blocks = strlen(type)>0 && strcmp(pc_type,PCJACOBI)!=0;
+
+  free(type);
+  free(pc_type);
+  return blocks;
+}
+
+// Configures pc as inner_pc, returns the fill of the preconditioner relative to the matrix
+static double setPreconditioner(InnerSolver *s, PC pc, Mat K)
+{
+  PetscBool upper, set;
+  char value[32];
+
+  PCSetType(pc,s->pc);
+  if(strcmp(s->pc,PCASM)==0) {
+    // The subdomain solves are incomplete factorizations, LDL^T-like for symmetric storage and
+    // by blocks with block storage (the fields of a node stay together). The command line
+    // keeps its own.
+    PCASMSetOverlap(pc,getOptIntLUA("inner_asm_overlap",1));
+    PetscObjectTypeCompareAny((PetscObject)K,&upper,MATSEQSBAIJ,MATMPISBAIJ,"");
+    PetscOptionsHasName(NULL,"-st_sub_pc_type",&set);
+    if(!set)
+      PetscOptionsSetValue("-st_sub_pc_type",upper ? PCICC : PCILU);
+    PetscOptionsHasName(NULL,"-st_sub_pc_factor_levels",&set);
+    if(!set) {
+      sprintf(value,"%i",getOptIntLUA("inner_ilu_levels",0));
+      PetscOptionsSetValue("-st_sub_pc_factor_levels",value);
+    }
+    return 1+getOptIntLUA("inner_ilu_levels",0);
+  } else if(strcmp(s->pc,PCGAMG)==0) {
+    // Aggregates take whole blocks of the operators (the fields of a node)
+    return GAMG_FILL;
+  }
+  return 0;
+}
+
+// Bytes of the inner solve (Krylov vectors and preconditioner) against the factors of a direct
+// LU, whose nested dissection fill grows like n^(4/3) on a 3D mesh
+static void estimateMemory(InnerSolver *s, Mat K, Mat D, Mat E, int vectors, double fill)
+{
+  int i;
+  PetscInt n;
+  MatInfo info;
+  Mat M[3] = {K,D,E};
+  double nnz=0, entry=sizeof(PetscScalar)+sizeof(PetscInt);
+
+  MatGetSize(K,&n,NULL);
+  for(i=0;i<3;i++)
+  {
+    MatGetInfo(M[i],MAT_GLOBAL_SUM,&info);
+    if(info.nz_used>nnz)
+      nnz = info.nz_used;
+  }
+  s->memory[0] = (double)vectors*n*sizeof(PetscScalar) + fill*nnz*entry;
+  s->memory[1] = nnz/n*pow(n,4.0/3.0)*entry;
+}
+
+InnerSolver *createInnerSolver(PEP pep, Mat K, Mat D, Mat E, bool matrix_free)
+{
+  ST st;
+  PC pc;
+  PetscReal tol;
+  char *type = getOptStringLUA("inner_solver","");
+  int restart, vectors;
+  double fill;
+
+  if(strlen(type)==0) {
+    free(type);
+    return NULL;
+  }
+  InnerSolver *s = malloc( sizeof(InnerSolver) );
+  if (s==NULL)
+    logError("#! Allocation of the inner solver failed\n");
+  char *pc_type = getOptStringLUA("inner_pc","asm");
+  PetscStrncpy(s->type,type,sizeof(s->type));
+  PetscStrncpy(s->pc,pc_type,sizeof(s->pc));
+  free(type);
+  free(pc_type);
+  if(strcmp(s->type,KSPGMRES)!=0 && strcmp(s->type,KSPBCGS)!=0)
+    logError("#! inner_solver '%s' is not one of gmres or bcgs\n",s->type);
+  if(strcmp(s->pc,PCASM)!=0 && strcmp(s->pc,PCGAMG)!=0 && strcmp(s->pc,PCJACOBI)!=0)
+    logError("#! inner_pc '%s' is not one of asm, gamg, or jacobi\n",s->pc);
+  if(matrix_free && strcmp(s->pc,PCJACOBI)!=0)
+    logError("#! Matrix-free operators are only preconditioned by inner_pc jacobi\n");
+
+  PEPGetTolerances(pep,&tol,NULL);
+  s->rtol = creal(getOptComplexLUA("inner_rtol",0));
+  if(s->rtol<=0)
+    s->rtol = 1e-2*tol;
+  s->rtol_max = creal(getOptComplexLUA("inner_rtol_max",1e-2));
+  if(s->rtol_max<s->rtol)
+    s->rtol_max = s->rtol;
+  restart = getOptIntLUA("inner_restart",30);
+
+  PEPGetST(pep,&st);
+  STGetKSP(st,&(s->ksp));
+  KSPSetType(s->ksp,s->type);
+  if(strcmp(s->type,KSPGMRES)==0) {
+    KSPGMRESSetRestart(s->ksp,restart);
+    vectors = restart+2;
+  } else {
+    vectors = BCGS_VECTORS;
+  }
+  KSPGetPC(s->ksp,&pc);
+  s->recycle = getOptIntLUA("inner_recycle",0);
+  s->base = NULL;
+  s->A = NULL;
+  s->X = s->U = s->C = NULL;
+  s->nx = s->next = s->nrecycled = 0;
+  s->h = NULL;
+  s->t = NULL;
+  if(s->recycle>0) {
+    // The preconditioner proper moves behind a shell deflating the recycle space (the prefix
+    // keeps the st_sub_ options of its subdomain solves)
+    s->h = malloc( s->recycle*sizeof(PetscScalar) );
+    if (s->h==NULL)
+      logError("#! Allocation of the inner solver failed\n");
+    PCCreate(PetscObjectComm((PetscObject)pc),&(s->base));
+    PCSetOptionsPrefix(s->base,"st_");
+    fill = setPreconditioner(s,s->base,K);
+    PCSetType(pc,PCSHELL);
+    PCShellSetContext(pc,s);
+    PCShellSetSetUp(pc,setupRecycled);
+    PCShellSetApply(pc,applyRecycled);
+    PCShellSetName(pc,"recycled");
+    KSPSetPostSolve(s->ksp,recordSolution,s);
+    vectors += 3*s->recycle+1;
+  } else {
+    fill = setPreconditioner(s,pc,K);
+  }
+  s->rtol_used = s->rtol;
+  s->solves = s->its = 0;
+  KSPSetTolerances(s->ksp,s->rtol,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT);
+  KSPMonitorSet(s->ksp,monitorInnerSolver,s,NULL);
+  PEPMonitorSet(pep,relaxInnerTolerance,s,NULL);
+
+  estimateMemory(s,K,D,E,vectors,fill);
+  logOutput("# inner solver: %s with %s, tolerance %.1E relaxed up to %.1E with the outer residual\n",
+            s->type,s->pc,s->rtol,s->rtol_max);
+  if(s->recycle>0)
+    logOutput("# inner solver: recycling the latest %i inner solutions across solves and parameters\n",s->recycle);
+  logOutput("# inner solver memory estimate: %.2f GB, direct LU about %.2f GB (nested dissection fill of a 3D mesh)\n",
+            s->memory[0]/1e9,s->memory[1]/1e9);
+  return s;
+}
+
+void resetInnerStats(InnerSolver *s)
+{
+  s->rtol_used = s->rtol;
+  s->solves = s->its = 0;
+  KSPSetTolerances(s->ksp,s->rtol,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT);
+}
+
+double meanInnerIterations(InnerSolver *s)
+{
+  return s->solves>0 ? (double)s->its/s->solves : 0;
+}
+
+void deleteInnerSolver(InnerSolver *s)
+{
+  if(s->t!=NULL) {
+    VecDestroyVecs(s->recycle,&(s->X));
+    VecDestroyVecs(s->recycle,&(s->U));
+    VecDestroyVecs(s->recycle,&(s->C));
+    VecDestroy(&(s->t));
+  }
+  if(s->base!=NULL)
+    PCDestroy(&(s->base));
+  free(s->h);
+  free(s);
+}
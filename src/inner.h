@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Iterative inner solver of the spectral transformation (GMRES or BiCGStab
+// with ASM, GAMG, or Jacobi) for shifted matricies too large to factor
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_INNER
+#define QEPPS_INNER
+
+typedef struct
+{
+  KSP ksp;                 // Inner solver of the spectral transformation
+  char type[16], pc[16];   // Its KSP and PC types
+  PetscReal rtol;          // Tolerance while the outer residual is 1 or larger
+  PetscReal rtol_max;      // Loosest tolerance as the outer residual goes down
+  PetscReal rtol_used;     // Loosest tolerance used since resetInnerStats()
+  int solves, its;         // Inner solves and iterations since resetInnerStats()
+  double memory[2];        // Estimated bytes of the iterative solve and of a direct LU
+  int recycle;             // Vectors of the recycle space, 0 for none
+  PC base;                 // Preconditioner the deflation by the recycle space wraps
+  Mat A;                   // Shifted matrix the recycle space is built for
+  Vec *X;                  // Latest inner solutions (normalized), the recycle space is built from
+  int nx, next;            // Solutions held, the one replaced next
+  Vec *U, *C;              // Recycle space and its orthonormal image C = A*U
+  int nrecycled;
+  PetscScalar *h;
+  Vec t;
+} InnerSolver;
+
+/*!
+ *  Returns whether inner_solver is set with an inner_pc (asm or gamg) that keeps the fields of a
+ *  node together, for which the totals are created with the block size of a node (block_size,
+ *  or detected on the shared pattern of E, D, and K, see AssemblyOptions)
+ */
+bool innerFieldBlocks(void);
+
+/*!
+ *  Reads inner_solver (gmres or bcgs, NULL is returned when empty) and inner_pc (asm, gamg, or
+ *  jacobi) from the QEPPS options table in the LUA state and sets them on the spectral
+ *  transformation of pep, overriding the command line. inner_asm_overlap, inner_ilu_levels, and
+ *  inner_restart tune them, -st_sub_ options on the command line take precedence. The inner
+ *  tolerance starts at inner_rtol (by default 1E-2 of the PEP tolerance) and is relaxed to
+ *  inner_rtol/r, at most inner_rtol_max, where r is the error estimate of the first unconverged
+ *  eigenpair. With inner_recycle > 0, the solutions of the latest inner solves (which the
+ *  eigenvectors near the shift dominate) are recycled: the preconditioner becomes U C^H r +
+ *  M^-1 (r - C C^H r) with C = A*U orthonormal, which solves exactly within the recycle space U
+ *  and deflates it from the Krylov iteration. The space fills up within a PEPSolve() and is
+ *  rebuilt for the new shifted matrix of every parameter from the newest solutions. K, D, and E
+ *  give the size and nonzeros of the memory estimate. Call after PEPSetFromOptions().
+ */
+InnerSolver *createInnerSolver(PEP pep, Mat K, Mat D, Mat E, bool matrix_free);
+
+/*!
+ *  Restores the starting tolerance and clears the iteration counts, once per PEPSolve()
+ */
+void resetInnerStats(InnerSolver *s);
+
+/*!
+ *  Returns the mean number of inner iterations per solve since resetInnerStats()
+ */
+double meanInnerIterations(InnerSolver *s);
+
+void deleteInnerSolver(InnerSolver *s);
+
+#endif
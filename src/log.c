@@ -21,16 +21,60 @@
 
 static FILE *fp=NULL;
 
+// Output captured between logBufferBegin() and logBufferEnd()
+static bool buffering=false;
+static char *buffer=NULL;
+static size_t buffer_len=0, buffer_size=0;
+
+// Only the first rank of MPI_COMM_WORLD writes the output
 static bool isRank0(void)
 {
   int rank;
-  MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  return rank==0;
+}
+
+// First rank of the ranks solving together (all of them unless split into a parameter farm).
+// Before PETSc is initialized (configuration errors) the ranks are not split yet.
+static bool isGroupRank0(void)
+{
+  int rank;
+  MPI_Comm_rank(PetscInitializeCalled ? PETSC_COMM_WORLD : MPI_COMM_WORLD,&rank);
   return rank==0;
 }
 
+// The ranks are split into groups that do not wait on each other
+static bool isSplit(void)
+{
+  return PetscInitializeCalled && PETSC_COMM_WORLD!=MPI_COMM_WORLD;
+}
+
+static void appendBuffer(const char *format, va_list args)
+{
+  va_list copy;
+  int n;
+
+  va_copy(copy,args);
+  n = vsnprintf(NULL,0,format,copy);
+  va_end(copy);
+  if(n<0)
+    return;
+  if(buffer_len+n+1 > buffer_size)
+  {
+    buffer_size = 2*(buffer_len+n+1);
+    buffer = realloc(buffer,buffer_size);
+    if(buffer==NULL) {
+      printf("#! Allocation of the log buffer failed\n");
+      exit(1);
+    }
+  }
+  vsnprintf(buffer+buffer_len,n+1,format,args);
+  buffer_len += n;
+}
+
 void logError(const char *format, ...)
 {
-  if(isRank0())
+  if(isGroupRank0())
   {
     va_list args;
     va_start(args,format);
@@ -45,12 +89,25 @@ void logError(const char *format, ...)
     }
     va_end(args);
   }
+  // The other groups would wait forever on this one in the collectives that merge the output
+  if(isSplit())
+    MPI_Abort(MPI_COMM_WORLD,1);
   exit(1);
 }
 
 void logOutput(const char *format, ...)
 {
-  if(isRank0())
+  if(buffering)
+  {
+    if(isGroupRank0())
+    {
+      va_list args;
+      va_start(args,format);
+      appendBuffer(format,args);
+      va_end(args);
+    }
+  }
+  else if(isRank0())
   {
     va_list args;
     va_start(args,format);
@@ -83,3 +140,39 @@ void logClose(void)
   }
 }
 
+void logBufferBegin(void)
+{
+  buffering = true;
+  buffer_len = 0;
+}
+
+char *logBufferEnd(void)
+{
+  char *text=NULL;
+
+  buffering = false;
+  if(isGroupRank0())
+  {
+    text = malloc(buffer_len+1);
+    if(text==NULL)
+      logError("#! Allocation of the log buffer failed\n");
+    if(buffer_len>0)
+      memcpy(text,buffer,buffer_len);
+    text[buffer_len] = '\0';
+  }
+  buffer_len = 0;
+  return text;
+}
+
+void logWrite(const char *text)
+{
+  if(isRank0() && text!=NULL)
+  {
+    fputs(text,stdout);
+    if(fp!=NULL)
+    {
+      fputs(text,fp);
+      fflush(fp);
+    }
+  }
+}
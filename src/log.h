@@ -22,4 +22,17 @@ void logOutput(char *format, ...);
 void logOpen(const char *filename);
 void logClose(void);
 
+/*!
+ *  Between these two calls logOutput() appends to a buffer on the first rank of
+ *  PETSC_COMM_WORLD instead of writing. logBufferEnd() returns a copy of it there (NULL on the
+ *  other ranks), free() must be called on it.
+ */
+void logBufferBegin(void);
+char *logBufferEnd(void);
+
+/*!
+ *  Writes text as is, on the first rank of MPI_COMM_WORLD only
+ */
+void logWrite(const char *text);
+
 #endif
@@ -0,0 +1,296 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Low-rank (Woodbury) updates of the shifted factor when the change of the
+// shifted matrix touches few rows
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include <petscblaslapack.h>
+#include "types.h"
+#include "assemble.h"
+#include "lowrank.h"
+#include "log.h"
+
+LowRankUpdate *createLowRankUpdate(Mat P, int max_rank)
+{
+  LowRankUpdate *u = malloc( sizeof(LowRankUpdate) );
+  if (u==NULL)
+    logError("#! Allocation of the low-rank update failed\n");
+  u->max_rank = max_rank;
+  MatDuplicate(P,MAT_COPY_VALUES,&(u->Pb));
+  MatDuplicate(P,MAT_DO_NOT_COPY_VALUES,&(u->Pd));
+  u->rank = 0;
+  u->rank_W = 0;
+  u->rows = malloc( max_rank*sizeof(PetscInt) );
+  u->Z = malloc( max_rank*max_rank*sizeof(PetscScalar) );
+  u->B = malloc( max_rank*max_rank*sizeof(PetscScalar) );
+  u->M = malloc( max_rank*max_rank*sizeof(PetscScalar) );
+  u->pivots = malloc( max_rank*sizeof(PetscBLASInt) );
+  u->g = malloc( max_rank*sizeof(PetscScalar) );
+  if (u->rows==NULL || u->Z==NULL || u->B==NULL || u->M==NULL || u->pivots==NULL || u->g==NULL)
+    logError("#! Allocation of the low-rank update failed\n");
+  // The solves of W are n*max_rank entries, only allocated once an update is needed
+  u->W = NULL;
+  MatGetVecs(P,&(u->t),NULL);
+  u->updates = 0;
+  return u;
+}
+
+void setLowRankBase(LowRankUpdate *u, Mat P)
+{
+  MatCopy(P,u->Pb,SAME_NONZERO_PATTERN);
+  u->rank = 0;
+  u->rank_W = 0;
+}
+
+// Collects the rows and columns of the nonzeros of Pd in rows, false when they are more than
+// max_rank. Collective.
+static bool findChange(LowRankUpdate *u, bool upper)
+{
+  PetscInt rstart, rend, r, k, nc, n=0, size=64, *local;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  bool touched;
+  int nranks, i, most, total, nlocal;
+  MPI_Comm comm = PetscObjectComm((PetscObject)u->Pd);
+
+  local = malloc( size*sizeof(PetscInt) );
+  if (local==NULL)
+    logError("#! Allocation of the low-rank update failed\n");
+  MatGetOwnershipRange(u->Pd,&rstart,&rend);
+  if(upper)
+    MatGetRowUpperTriangular(u->Pd);
+  for(r=rstart;r<rend;r++)
+  {
+    MatGetRow(u->Pd,r,&nc,&cols,&vals);
+    touched = false;
+    for(k=0;k<nc;k++)
+    {
+      if(vals[k]==0)
+        continue;
+      if(n+2>size) {
+        size *= 2;
+        local = realloc(local,size*sizeof(PetscInt));
+        if (local==NULL)
+          logError("#! Allocation of the low-rank update failed\n");
+      }
+      local[n++] = cols[k];
+      touched = true;
+    }
+    if(touched)
+      local[n++] = r;
+    MatRestoreRow(u->Pd,r,&nc,&cols,&vals);
+    // A large change is given up on below
+    if(n>u->max_rank) {
+      PetscSortRemoveDupsInt(&n,local);
+      if(n>u->max_rank)
+        break;
+    }
+  }
+  if(upper)
+    MatRestoreRowUpperTriangular(u->Pd);
+  PetscSortRemoveDupsInt(&n,local);
+
+  nlocal = n;
+  MPI_Allreduce(&nlocal,&most,1,MPI_INT,MPI_MAX,comm);
+  if(most>u->max_rank) {
+    free(local);
+    return false;
+  }
+  MPI_Comm_size(comm,&nranks);
+  int counts[nranks], displs[nranks];
+  PetscInt *all = malloc( (nranks*u->max_rank>0 ? nranks*u->max_rank : 1)*sizeof(PetscInt) );
+  if (all==NULL)
+    logError("#! Allocation of the low-rank update failed\n");
+  MPI_Allgather(&nlocal,1,MPI_INT,counts,1,MPI_INT,comm);
+  for(i=0, total=0;i<nranks;i++)
+  {
+    displs[i] = total;
+    total += counts[i];
+  }
+  MPI_Allgatherv(local,nlocal,MPIU_INT,all,counts,displs,MPIU_INT,comm);
+  free(local);
+  n = total;
+  PetscSortRemoveDupsInt(&n,all);
+  if(n>u->max_rank) {
+    free(all);
+    return false;
+  }
+  u->rank = n;
+  // W belongs to the rows it was solved for
+  if(n>0 && (n!=u->rank_W || memcmp(u->rows,all,n*sizeof(PetscInt))!=0)) {
+    u->rank_W = 0;
+    memcpy(u->rows,all,n*sizeof(PetscInt));
+  }
+  free(all);
+  return true;
+}
+
+// out[i] = v[rows[i]] on every rank
+static void gatherOnChange(LowRankUpdate *u, Vec v, PetscScalar *out)
+{
+  PetscInt start, end;
+  PetscScalar *a;
+  int i;
+
+  VecGetOwnershipRange(v,&start,&end);
+  VecGetArray(v,&a);
+  for(i=0;i<u->rank;i++)
+    out[i] = u->rows[i]>=start && u->rows[i]<end ? a[u->rows[i]-start] : 0;
+  VecRestoreArray(v,&a);
+  MPI_Allreduce(MPI_IN_PLACE,out,u->rank,MPIU_SCALAR,MPIU_SUM,PetscObjectComm((PetscObject)v));
+}
+
+// W = Pb^-1 I and Z = I^T W, one solve per row of the change
+static void solveChangeRows(LowRankUpdate *u, Mat F)
+{
+  PetscInt start, end;
+  int j, n=u->rank;
+
+  if(u->W==NULL)
+    VecDuplicateVecs(u->t,u->max_rank,&(u->W));
+  VecGetOwnershipRange(u->t,&start,&end);
+  for(j=0;j<n;j++)
+  {
+    VecSet(u->t,0);
+    if(u->rows[j]>=start && u->rows[j]<end)
+      VecSetValue(u->t,u->rows[j],1,INSERT_VALUES);
+    VecAssemblyBegin(u->t);
+    VecAssemblyEnd(u->t);
+    MatSolve(F,u->t,u->W[j]);
+    gatherOnChange(u,u->W[j],&(u->Z[j*n]));
+  }
+  u->rank_W = n;
+}
+
+// B = I^T Pd I, mirrored when only the upper triangle is stored
+static void extractChange(LowRankUpdate *u, bool upper)
+{
+  PetscInt rstart, rend, k, nc, j;
+  const PetscInt *cols;
+  const PetscScalar *vals;
+  int i, n=u->rank;
+
+  memset(u->B,0,n*n*sizeof(PetscScalar));
+  MatGetOwnershipRange(u->Pd,&rstart,&rend);
+  if(upper)
+    MatGetRowUpperTriangular(u->Pd);
+  for(i=0;i<n;i++)
+  {
+    if(u->rows[i]<rstart || u->rows[i]>=rend)
+      continue;
+    MatGetRow(u->Pd,u->rows[i],&nc,&cols,&vals);
+    for(k=0;k<nc;k++)
+    {
+      PetscFindInt(cols[k],n,u->rows,&j);
+      if(j<0)
+        continue;
+      u->B[i+j*n] = vals[k];
+      if(upper && j!=i)
+        u->B[j+i*n] = vals[k];
+    }
+    MatRestoreRow(u->Pd,u->rows[i],&nc,&cols,&vals);
+  }
+  if(upper)
+    MatRestoreRowUpperTriangular(u->Pd);
+  MPI_Allreduce(MPI_IN_PLACE,u->B,n*n,MPIU_SCALAR,MPIU_SUM,PetscObjectComm((PetscObject)u->Pd));
+}
+
+bool updateLowRank(LowRankUpdate *u, Mat P, Mat F, bool upper)
+{
+  int i, j, k, n;
+  PetscBLASInt bn, info;
+
+  MatCopy(P,u->Pd,SAME_NONZERO_PATTERN);
+  MatAXPY(u->Pd,-1,u->Pb,SAME_NONZERO_PATTERN);
+  if(!findChange(u,upper))
+    return false;
+  n = u->rank;
+  if(n==0) {
+    u->updates++;
+    return true;
+  }
+  // The solves only depend on the rows, which stay the same while one component changes
+  if(u->rank_W==0)
+    solveChangeRows(u,F);
+  extractChange(u,upper);
+
+  // I + Z B, factored
+  for(j=0;j<n;j++)
+  {
+    for(i=0;i<n;i++)
+    {
+      u->M[i+j*n] = i==j ? 1 : 0;
+      for(k=0;k<n;k++)
+        u->M[i+j*n] += u->Z[i+k*n]*u->B[k+j*n];
+    }
+  }
+  PetscBLASIntCast(n,&bn);
+  LAPACKgetrf_(&bn,&bn,u->M,&bn,u->pivots,&info);
+  if(info!=0)
+    return false;
+  u->updates++;
+  return true;
+}
+
+void applyLowRank(LowRankUpdate *u, Mat F, Vec x, Vec y)
+{
+  int i, k, n;
+  PetscBLASInt bn, one=1, info;
+  PetscScalar h[u->rank>0 ? u->rank : 1];
+
+  MatSolve(F,x,y);
+  n = u->rank;
+  if(n==0)
+    return;
+  // y -= W B (I + Z B)^-1 I^T y
+  gatherOnChange(u,y,u->g);
+  PetscBLASIntCast(n,&bn);
+  LAPACKgetrs_("N",&bn,&one,u->M,&bn,u->pivots,u->g,&bn,&info);
+  for(i=0;i<n;i++)
+  {
+    h[i] = 0;
+    for(k=0;k<n;k++)
+      h[i] -= u->B[i+k*n]*u->g[k];
+  }
+  VecMAXPY(y,n,h,u->W);
+}
+
+void reportLowRankComponents(MatrixAssembler *A, int max_rank)
+{
+  int i, total;
+
+  for(i=0;i<A->Mc->num;i++)
+  {
+    total = componentRows(A,i);
+    if(total<=max_rank)
+      logOutput("# low-rank updates: component %i of %s touches %i rows, its changes alone are updated\n",i,A->name,total);
+  }
+}
+
+void deleteLowRankUpdate(LowRankUpdate *u)
+{
+  MatDestroy(&(u->Pb));
+  MatDestroy(&(u->Pd));
+  if(u->W!=NULL)
+    VecDestroyVecs(u->max_rank,&(u->W));
+  VecDestroy(&(u->t));
+  free(u->rows);
+  free(u->Z);
+  free(u->B);
+  free(u->M);
+  free(u->pivots);
+  free(u->g);
+  free(u);
+}
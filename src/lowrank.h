@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Low-rank (Woodbury) updates of the shifted factor when the change of the
+// shifted matrix touches few rows
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_LOWRANK
+#define QEPPS_LOWRANK
+
+typedef struct
+{
+  int max_rank;            // Most rows (and columns) a change may touch
+  Mat Pb, Pd;              // Shifted matrix at the last factorization, and the change since
+  int rank;                // Rows the current change touches, 0 when the factor is exact
+  PetscInt *rows;          // Their global indices, sorted
+  int rank_W;              // Rows W holds the solves of (rows[0..rank_W)), 0 when not computed
+  Vec *W;                  // Pb^-1 e_r for the rows r of the change
+  PetscScalar *Z;          // I^T Pb^-1 I, the rows of W on the change (column major)
+  PetscScalar *B;          // I^T (P - Pb) I, the change itself
+  PetscScalar *M;          // LU factors of I + Z B
+  PetscBLASInt *pivots;
+  PetscScalar *g;          // Work array
+  Vec t;
+  int updates;             // Factorizations replaced by an update
+} LowRankUpdate;
+
+/*!
+ *  Sets up updates of changes to P touching at most max_rank rows. P keeps its pattern.
+ */
+LowRankUpdate *createLowRankUpdate(Mat P, int max_rank);
+
+/*!
+ *  Makes P, just factored, the base of the updates
+ */
+void setLowRankBase(LowRankUpdate *u, Mat P);
+
+/*!
+ *  Finds the rows and columns P - Pb touches (both sides of the diagonal when only the upper
+ *  triangle is stored). When there are at most max_rank, the factor F of Pb stays and the
+ *  change I B I^T is taken by the Woodbury identity
+ *  P^-1 = Pb^-1 - W B (I + Z B)^-1 I^T Pb^-1, with W = Pb^-1 I and Z = I^T W computed by one
+ *  solve per row (only when the rows differ from the last update). Returns false otherwise.
+ */
+bool updateLowRank(LowRankUpdate *u, Mat P, Mat F, bool upper);
+
+/*!
+ *  y = P^-1 x from the factor F of the base and the current update
+ */
+void applyLowRank(LowRankUpdate *u, Mat F, Vec x, Vec y);
+
+/*!
+ *  Logs the components of the assembler A whose nonzeros touch at most max_rank rows (those
+ *  whose changes alone can be updated)
+ */
+void reportLowRankComponents(MatrixAssembler *A, int max_rank);
+
+void deleteLowRankUpdate(LowRankUpdate *u);
+
+#endif
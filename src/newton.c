@@ -0,0 +1,167 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Single-mode tracking: Rayleigh quotient iteration on the QEP, refining
+// the eigenpair of the previous parameter in place of a Krylov solve
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include "types.h"
+#include "config.h"
+#include "assemble.h"
+#include "lowrank.h"
+#include "condense.h"
+#include "factor.h"
+#include "newton.h"
+#include "log.h"
+
+// Smallest overlap of the refined vector with the previous mode accepted as the same mode
+#define MIN_MODE_OVERLAP 0.5
+
+NewtonSolver *createNewtonSolver(Mat A, bool symmetric)
+{
+  int i, max_its = getOptIntLUA("newton_max_its",0);
+
+  if(max_its<=0)
+    return NULL;
+  NewtonSolver *n = malloc( sizeof(NewtonSolver) );
+  if (n==NULL)
+    logError("#! Allocation of the newton tracking solver failed\n");
+  n->max_its = max_its;
+  n->tol = creal(getOptComplexLUA("newton_tolerance",1e-8));
+  n->symmetric = symmetric;
+  n->known = false;
+  MatGetVecs(A,&(n->u),NULL);
+  VecDuplicate(n->u,&(n->u0));
+  for(i=0;i<4;i++)
+    VecDuplicate(n->u,&(n->w[i]));
+  n->lambda = 0;
+  n->its = 0;
+  n->residual = 0;
+  n->solved = 0;
+  n->fallbacks = 0;
+  logOutput("# newton tracking: up to %i factorizations per parameter to a relative residual of %.1E, full solve otherwise\n",
+            n->max_its,n->tol);
+  return n;
+}
+
+void resetNewtonSolver(NewtonSolver *n)
+{
+  n->known = false;
+}
+
+void setNewtonMode(NewtonSolver *n, Vec U)
+{
+  VecCopy(U,n->u0);
+  VecNormalize(n->u0,NULL);
+  n->known = true;
+}
+
+// u^H v, or u^T v for complex symmetric operators (whose left eigenvectors are conj(u))
+static PetscScalar quotientDot(NewtonSolver *n, Vec v)
+{
+  PetscScalar d;
+  if(n->symmetric)
+    VecTDot(v,n->u,&d);
+  else
+    VecDot(v,n->u,&d);
+  return d;
+}
+
+// Applies K, D, and E to u (into w[0], w[1], w[2]) and returns the root of the quadratic
+// Rayleigh quotient c + b*mu + a*mu^2 = 0 nearest mu
+static PetscScalar rayleighQuotient(NewtonSolver *n, Mat K, Mat D, Mat E, PetscScalar mu)
+{
+  PetscScalar a, b, c, q, disc, root[2];
+
+  MatMult(K,n->u,n->w[0]);
+  MatMult(D,n->u,n->w[1]);
+  MatMult(E,n->u,n->w[2]);
+  c = quotientDot(n,n->w[0]);
+  b = quotientDot(n,n->w[1]);
+  a = quotientDot(n,n->w[2]);
+  if(a==0)
+    return b!=0 ? -c/b : mu;
+  // The root of larger magnitude first, without cancellation, the other from their product
+  disc = PetscSqrtScalar(b*b-4*a*c);
+  q = PetscRealPart(PetscConj(b)*disc)>=0 ? -(b+disc)/2 : -(b-disc)/2;
+  root[0] = q/a;
+  root[1] = q!=0 ? c/q : root[0];
+  return PetscAbsScalar(root[0]-mu)<=PetscAbsScalar(root[1]-mu) ? root[0] : root[1];
+}
+
+// Relative residual |(K + l*D + l^2*E)u| / (|Ku| + |l||Du| + |l|^2|Eu|) from the products in
+// w[0], w[1], w[2], the residual left in w[3]
+static PetscReal relativeResidual(NewtonSolver *n, PetscScalar l)
+{
+  PetscReal norm[4], al=PetscAbsScalar(l);
+
+  VecNorm(n->w[0],NORM_2,&norm[0]);
+  VecNorm(n->w[1],NORM_2,&norm[1]);
+  VecNorm(n->w[2],NORM_2,&norm[2]);
+  VecCopy(n->w[0],n->w[3]);
+  VecAXPY(n->w[3],l,n->w[1]);
+  VecAXPY(n->w[3],l*l,n->w[2]);
+  VecNorm(n->w[3],NORM_2,&norm[3]);
+  return norm[3]/(norm[0]+al*norm[1]+al*al*norm[2]);
+}
+
+bool solveNewton(NewtonSolver *n, ShiftedFactor *f, Mat K, Mat D, Mat E, PetscScalar target)
+{
+  PetscScalar mu, overlap;
+
+  n->its = 0;
+  n->residual = 0;
+  if(!n->known)
+    return false;
+  VecCopy(n->u0,n->u);
+  mu = rayleighQuotient(n,K,D,E,target);
+  n->residual = relativeResidual(n,mu);
+  while(n->residual>n->tol && n->its<n->max_its)
+  {
+    // Inverse iteration with T'(mu)u = (D + 2*mu*E)u, whose shift converges with the quotient
+    VecWAXPY(n->w[3],2*mu,n->w[2],n->w[1]);
+    factorShifted(f,mu);
+    solveShifted(f,n->w[3],n->u);
+    VecNormalize(n->u,NULL);
+    n->its++;
+    mu = rayleighQuotient(n,K,D,E,mu);
+    n->residual = relativeResidual(n,mu);
+  }
+  n->lambda = mu;
+  VecDot(n->u,n->u0,&overlap);
+  if(!(n->residual<=n->tol) || PetscAbsScalar(overlap)<MIN_MODE_OVERLAP)
+  {
+    n->fallbacks++;
+    return false;
+  }
+  n->solved++;
+  return true;
+}
+
+void getNewtonEigenpair(NewtonSolver *n, PetscScalar *lambda, Vec U)
+{
+  *lambda = n->lambda;
+  VecCopy(n->u,U);
+}
+
+void deleteNewtonSolver(NewtonSolver *n)
+{
+  int i;
+
+  VecDestroy(&(n->u));
+  VecDestroy(&(n->u0));
+  for(i=0;i<4;i++)
+    VecDestroy(&(n->w[i]));
+  free(n);
+}
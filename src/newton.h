@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Single-mode tracking: Rayleigh quotient iteration on the QEP, refining
+// the eigenpair of the previous parameter in place of a Krylov solve
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_NEWTON
+#define QEPPS_NEWTON
+
+typedef struct
+{
+  int max_its;             // Factorizations per parameter before falling back to the full solve
+  double tol;              // Relative residual the refined eigenpair is accepted with
+  bool symmetric;          // Complex symmetric operators, the Rayleigh quotient uses u^T for u^H
+  bool known;              // u holds the mode of the previous parameter
+  Vec u, u0, w[4];         // Iterate, mode of the previous parameter, work vectors
+  PetscScalar lambda;      // Eigenvalue (scaled) of the last refinement
+  int its;                 // Factorizations of the last refinement
+  PetscReal residual;      // Its relative residual
+  int solved, fallbacks;   // Parameters solved by refinement, by the full solve after it failed
+} NewtonSolver;
+
+/*!
+ *  Reads newton_max_its and newton_tolerance from the QEPPS options table in the LUA state and
+ *  returns NULL when newton_max_its is not positive. Vectors are laid out like those of A.
+ *  symmetric selects the complex symmetric Rayleigh quotient u^T T(mu) u = 0.
+ */
+NewtonSolver *createNewtonSolver(Mat A, bool symmetric);
+
+/*!
+ *  Forgets the mode, the next parameter needs a full solve
+ */
+void resetNewtonSolver(NewtonSolver *n);
+
+/*!
+ *  Records U as the mode to refine at the next parameter
+ */
+void setNewtonMode(NewtonSolver *n, Vec U);
+
+/*!
+ *  Refines the recorded mode for the current K, D, and E by Rayleigh quotient iteration: the
+ *  eigenvalue is the root of the quadratic Rayleigh quotient nearest target (then nearest the
+ *  last shift), the vector takes an inverse iteration step with T(mu) = K + mu*D + mu^2*E
+ *  factored by f at every shift. Returns false when no mode is recorded, or when the relative
+ *  residual does not reach the tolerance within max_its factorizations, or the vector turned
+ *  away from the recorded mode. f then holds the factor of the last shift.
+ */
+bool solveNewton(NewtonSolver *n, ShiftedFactor *f, Mat K, Mat D, Mat E, PetscScalar target);
+
+/*!
+ *  Returns the eigenpair of the last refinement
+ */
+void getNewtonEigenpair(NewtonSolver *n, PetscScalar *lambda, Vec U);
+
+void deleteNewtonSolver(NewtonSolver *n);
+
+#endif
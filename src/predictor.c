@@ -0,0 +1,187 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Extrapolation of the tracked eigenvalue from the last parameters of the
+// sweep, used as the target of the next solve
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "config.h"
+#include "predictor.h"
+#include "log.h"
+
+static const char *predictor_names[] = {"none","linear","quadratic","rational"};
+
+EigenvaluePredictor *createPredictor(void)
+{
+  int t;
+  char *type = getOptStringLUA("predictor","none");
+
+  EigenvaluePredictor *P = malloc( sizeof(EigenvaluePredictor) );
+  if (P==NULL)
+    logError("#! Allocation of the eigenvalue predictor failed\n");
+  P->type = PREDICT_NONE;
+  for(t=PREDICT_NONE;t<=PREDICT_RATIONAL;t++)
+    if( strcmp(type,predictor_names[t])==0 )
+      P->type = t;
+  if( P->type==PREDICT_NONE && strcmp(type,"none")!=0 )
+    logError("#! Unknown predictor '%s', use none, linear, quadratic, or rational\n",type);
+  free(type);
+
+  P->points = getOptIntLUA("predictor_points",3);
+  if(P->points<1)
+    P->points = 1;
+  if(P->points>MAX_PREDICTOR_POINTS)
+    P->points = MAX_PREDICTOR_POINTS;
+  P->error_sum = P->error_max = 0;
+  P->errors = 0;
+  resetPredictor(P);
+  if(P->type!=PREDICT_NONE)
+    logOutput("# %s eigenvalue predictor over the last %i parameters\n",predictor_names[P->type],P->points);
+  return P;
+}
+
+void resetPredictor(EigenvaluePredictor *P)
+{
+  P->n = 0;
+  P->predicted = false;
+  P->checked = false;
+  P->error = 0;
+}
+
+// Solves the leading nu x nu system N*c = r in place (Gaussian elimination with partial pivoting),
+// returns false when it is singular
+static bool solveSmall(int nu, double complex N[3][3], double complex r[3], double complex c[3])
+{
+  int i, j, k, piv;
+  double complex f, tmp;
+
+  for(k=0;k<nu;k++)
+  {
+    piv = k;
+    for(i=k+1;i<nu;i++)
+      if( cabs(N[i][k]) > cabs(N[piv][k]) ) piv = i;
+    if( cabs(N[piv][k]) < 1e-14*(cabs(N[0][0])+1e-300) )
+      return false;
+    for(j=0;j<nu;j++) { tmp=N[k][j]; N[k][j]=N[piv][j]; N[piv][j]=tmp; }
+    tmp=r[k]; r[k]=r[piv]; r[piv]=tmp;
+    for(i=k+1;i<nu;i++)
+    {
+      f = N[i][k]/N[k][k];
+      for(j=k;j<nu;j++) N[i][j] -= f*N[k][j];
+      r[i] -= f*r[k];
+    }
+  }
+  for(k=nu-1;k>=0;k--)
+  {
+    c[k] = r[k];
+    for(j=k+1;j<nu;j++) c[k] -= N[k][j]*c[j];
+    c[k] /= N[k][k];
+  }
+  return true;
+}
+
+// Least squares fit of the given type over the last points of the history, evaluated at x.
+// Returns false when there are too few points or the fit is singular.
+static bool fitHistory(EigenvaluePredictor *P, PredictorType type, double complex x, double complex *lambda)
+{
+  int nu = type==PREDICT_LINEAR ? 2 : 3;
+  int m = P->n < P->points ? P->n : P->points;
+  int i, j, k;
+  double complex N[3][3], r[3], c[3], row[3], t, xl=P->x[P->n-1], h=1, den;
+
+  if(m<nu)
+    return false;
+  // Shift and scale the parameter so that the last points sit at 0, -1, ...
+  if( P->n>1 && cabs(xl-P->x[P->n-2])>0 )
+    h = xl-P->x[P->n-2];
+
+  for(i=0;i<nu;i++)
+  {
+    r[i] = 0;
+    for(j=0;j<nu;j++) N[i][j] = 0;
+  }
+  for(k=P->n-m;k<P->n;k++)
+  {
+    t = (P->x[k]-xl)/h;
+    row[0] = 1;
+    row[1] = t;
+    row[2] = type==PREDICT_RATIONAL ? -t*P->lambda[k] : t*t;
+    for(i=0;i<nu;i++)
+    {
+      r[i] += conj(row[i])*P->lambda[k];
+      for(j=0;j<nu;j++) N[i][j] += conj(row[i])*row[j];
+    }
+  }
+  if( !solveSmall(nu,N,r,c) )
+    return false;
+
+  t = (x-xl)/h;
+  if(type==PREDICT_RATIONAL) {
+    den = 1+c[2]*t;
+    if( cabs(den)<1e-12 )
+      return false;
+    *lambda = (c[0]+c[1]*t)/den;
+  } else {
+    *lambda = c[0]+c[1]*t;
+    if(type==PREDICT_QUADRATIC)
+      *lambda += c[2]*t*t;
+  }
+  return true;
+}
+
+double complex predictEigenvalue(EigenvaluePredictor *P, double complex x, double complex fallback)
+{
+  double complex lambda;
+
+  P->predicted = false;
+  P->checked = false;
+  if( P->type==PREDICT_NONE || P->n==0 )
+    return fallback;
+  // Fewer points (or a singular fit) fall back to a line, then to the last eigenvalue
+  if( !fitHistory(P,P->type,x,&lambda) &&
+      (P->type==PREDICT_LINEAR || !fitHistory(P,PREDICT_LINEAR,x,&lambda)) )
+    lambda = P->lambda[P->n-1];
+  P->predicted = true;
+  P->target = lambda;
+  return lambda;
+}
+
+void updatePredictor(EigenvaluePredictor *P, double complex x, double complex lambda)
+{
+  int k;
+
+  if(P->predicted) {
+    P->checked = true;
+    P->error = cabs(lambda-P->target);
+    P->error_sum += P->error;
+    if(P->error>P->error_max) P->error_max = P->error;
+    P->errors++;
+  }
+  if(P->n==MAX_PREDICTOR_POINTS) {
+    for(k=1;k<P->n;k++) {
+      P->x[k-1] = P->x[k];
+      P->lambda[k-1] = P->lambda[k];
+    }
+    P->n--;
+  }
+  P->x[P->n] = x;
+  P->lambda[P->n] = lambda;
+  P->n++;
+}
+
+void deletePredictor(EigenvaluePredictor *P)
+{
+  free(P);
+}
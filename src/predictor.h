@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Extrapolation of the tracked eigenvalue from the last parameters of the
+// sweep, used as the target of the next solve
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_PREDICTOR
+#define QEPPS_PREDICTOR
+
+#define MAX_PREDICTOR_POINTS 8
+
+typedef enum
+{
+  PREDICT_NONE=0,          // No prediction, the target is left alone
+  PREDICT_LINEAR,          // Least squares line through the history
+  PREDICT_QUADRATIC,       // Least squares parabola
+  PREDICT_RATIONAL         // Least squares (a+b*x)/(1+c*x)
+} PredictorType;
+
+typedef struct
+{
+  PredictorType type;
+  int points;              // History length used for the fit
+  int n;                   // Points in the history, most recent last
+  double complex x[MAX_PREDICTOR_POINTS], lambda[MAX_PREDICTOR_POINTS];
+  bool predicted;          // The current target came from the history
+  double complex target;   // Last prediction
+  bool checked;            // updatePredictor() compared the current target with a solution
+  double error;            // |lambda - target| of the last prediction, valid when checked
+  double error_sum, error_max;
+  int errors;              // Predictions checked against a solution
+} EigenvaluePredictor;
+
+/*!
+ *  Reads the predictor (none, linear, quadratic, or rational) and predictor_points options
+ *  from the QEPPS options table in the LUA state
+ */
+EigenvaluePredictor *createPredictor(void);
+
+/*!
+ *  Forgets the history, e.g. when the sweep jumps to another part of the parameter range
+ */
+void resetPredictor(EigenvaluePredictor *P);
+
+/*!
+ *  Returns the eigenvalue extrapolated to parameter value x from the history. The fit drops
+ *  to a lower degree (down to the last eigenvalue) while there are too few points, and
+ *  fallback is returned when there are none.
+ */
+double complex predictEigenvalue(EigenvaluePredictor *P, double complex x, double complex fallback);
+
+/*!
+ *  Adds the eigenvalue solved at parameter value x to the history and records the error of
+ *  the prediction made for it.
+ */
+void updatePredictor(EigenvaluePredictor *P, double complex x, double complex lambda);
+
+void deletePredictor(EigenvaluePredictor *P);
+
+#endif
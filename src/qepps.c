@@ -20,20 +20,33 @@
 #include "types.h"
 #include "sweeper.h"
 #include "config.h"
+#include "farm.h"
+#include "slice.h"
 #include "log.h"
 
 #undef __FUNCT__
 #define __FUNCT__ "main"
 int main(int argc,char **argv)
 {
-  char filename[PETSC_MAX_PATH_LEN];
-  SlepcInitialize(&argc,&argv,(char*)0,help);
+  const char *filename=NULL;
+  int i;
+  MPI_Init(&argc,&argv);
   
-  /* Start LUA state and load configuration */
+  /* Start LUA state and load configuration (before PETSc, it decides how the ranks are split) */
+  for(i=1;i<argc-1;i++)
+    if( strcmp(argv[i],"-lua")==0 )
+      filename = argv[i+1];
+  if( filename==NULL )
+    logError("#! No configuration given, use -lua <file>\n");
   startLUA();
-  PetscOptionsGetString(NULL,"-lua",filename,PETSC_MAX_PATH_LEN,NULL);
   parseConfigLUA(filename);
   
+  /* Optionally split the ranks into groups that solve different parameters, or one group per
+     slice of the spectrum */
+  MPI_Comm group = splitWorld(getSliceCount()>1 ? sliceRanksPerGroup() : getOptIntLUA("ranks_per_group",0));
+  PETSC_COMM_WORLD = group;
+  SlepcInitialize(&argc,&argv,(char*)0,help);
+  
   /* Setup the log file */
   char *output_file = getOptStringLUA("output_log","./output.txt");
   logOpen(output_file);
@@ -46,6 +59,9 @@ int main(int argc,char **argv)
   closeLUA();
   logClose();
   SlepcFinalize();
+  if( group!=MPI_COMM_WORLD )
+    MPI_Comm_free(&group);
+  MPI_Finalize();
    
   return 0;
 }
@@ -0,0 +1,175 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Adaptive parameter refinement: inserts parameters where the linear
+// interpolation of the solved eigenvalues is not accurate enough
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "refine.h"
+#include "config.h"
+#include "log.h"
+
+// Narrowest interval split, relative to the seed range
+#define MIN_REFINE_WIDTH 1e-6
+
+ParameterRefiner *createParameterRefiner(int modes)
+{
+  int i, j, s;
+  double complex x;
+  double tol = creal(getOptComplexLUA("refine_tolerance",0));
+
+  if( tol<=0 )
+    return NULL;
+  ParameterRefiner *r = malloc( sizeof(ParameterRefiner) );
+  if (r==NULL)
+    logError("#! Allocation of the parameter refiner failed\n");
+  r->tol = tol;
+  r->modes = modes>0 ? modes : 1;
+  r->nseeds = getNumberOfParameters();
+  r->capacity = getOptIntLUA("refine_max_points",200);
+  if( r->capacity<r->nseeds )
+    r->capacity = r->nseeds;
+  r->seeds = malloc( sizeof(int)*r->nseeds );
+  r->x = malloc( sizeof(double)*r->capacity );
+  r->lambda = malloc( sizeof(double complex)*r->capacity*r->modes );
+  r->text = malloc( sizeof(char*)*r->capacity );
+  if (r->seeds==NULL || r->x==NULL || r->lambda==NULL || r->text==NULL)
+    logError("#! Allocation of the parameter refiner failed\n");
+
+  // Seeds in increasing order
+  for(i=0;i<r->nseeds;i++)
+  {
+    x = getParameterValue(i);
+    if( cimag(x)!=0 )
+      logError("#! Adaptive refinement needs real parameters, parameters[%i] is complex\n",i+1);
+    for(j=i;j>0 && creal(getParameterValue(r->seeds[j-1]))>creal(x);j--)
+      r->seeds[j] = r->seeds[j-1];
+    r->seeds[j] = i;
+  }
+  if( r->nseeds<2 )
+    logError("#! Adaptive refinement needs at least the two ends of the interval as parameters\n");
+  s = r->nseeds-1;
+  r->min_width = MIN_REFINE_WIDTH*(creal(getParameterValue(r->seeds[s]))-creal(getParameterValue(r->seeds[0])));
+  r->next_seed = 0;
+  r->n = 0;
+  r->last = 0;
+  r->inserted = 0;
+  logOutput("# adaptive refinement: relative tolerance %.1E, %i seeds, at most %i parameters\n",
+            r->tol,r->nseeds,r->capacity);
+  return r;
+}
+
+// Relative error of the linear interpolation over interval i from the curvature of the
+// neighbouring triples, INFINITY while the interval has no neighbour
+static double interpolationError(const ParameterRefiner *r, int i)
+{
+  int t, k, m=r->modes;
+  double w=r->x[i+1]-r->x[i], error=0, scale;
+  double complex d2;
+  const double complex *f;
+  const double *x;
+  bool estimated=false;
+
+  for(t=i-1;t<=i;t++)
+  {
+    if( t<0 || t+2>=r->n )
+      continue;
+    estimated = true;
+    x = r->x+t;
+    for(k=0;k<m;k++)
+    {
+      f = r->lambda+t*m+k;
+      if( isnan(creal(f[0])) || isnan(creal(f[m])) || isnan(creal(f[2*m])) )
+        continue;
+      d2 = 2*( (f[2*m]-f[m])/(x[2]-x[1]) - (f[m]-f[0])/(x[1]-x[0]) )/(x[2]-x[0]);
+      scale = fmax(cabs(r->lambda[i*m+k]),cabs(r->lambda[(i+1)*m+k]));
+      if( scale>0 )
+        error = fmax(error,cabs(d2)*w*w/8/scale);
+    }
+  }
+  return estimated ? error : INFINITY;
+}
+
+int nextRefinedParameter(ParameterRefiner *r)
+{
+  int i, best=-1;
+  double dist, best_dist=INFINITY, error;
+
+  // The remaining seeds keep their room
+  if( r->n+r->nseeds-r->next_seed<r->capacity )
+  {
+    for(i=0;i+1<r->n;i++)
+    {
+      if( r->x[i+1]-r->x[i]<=r->min_width )
+        continue;
+      error = interpolationError(r,i);
+      if( error<=r->tol || (isinf(error) && r->next_seed<r->nseeds) )
+        continue;
+      dist = fabs(0.5*(r->x[i]+r->x[i+1])-r->x[r->last]);
+      if( dist<best_dist )
+      {
+        best_dist = dist;
+        best = i;
+      }
+    }
+  }
+  if( best>=0 )
+  {
+    r->inserted++;
+    return appendParameterValue(0.5*(r->x[best]+r->x[best+1]));
+  }
+  if( r->next_seed<r->nseeds )
+    return r->seeds[r->next_seed++];
+  return -1;
+}
+
+void endRefinedParameter(ParameterRefiner *r, int p, const double complex *lambda)
+{
+  int i, m=r->modes;
+  double x = creal(getParameterValue(p));
+
+  for(i=r->n;i>0 && r->x[i-1]>x;i--)
+  {
+    r->x[i] = r->x[i-1];
+    r->text[i] = r->text[i-1];
+    memcpy(r->lambda+i*m,r->lambda+(i-1)*m,sizeof(double complex)*m);
+  }
+  r->x[i] = x;
+  r->text[i] = logBufferEnd();
+  memcpy(r->lambda+i*m,lambda,sizeof(double complex)*m);
+  r->last = i;
+  r->n++;
+}
+
+void writeRefinedSweep(ParameterRefiner *r)
+{
+  int i;
+  for(i=0;i<r->n;i++)
+    logWrite(r->text[i]);
+  logOutput("# adaptive refinement: %i parameters solved, %i inserted between %i seeds\n",
+            r->n,r->inserted,r->nseeds);
+}
+
+void deleteParameterRefiner(ParameterRefiner *r)
+{
+  int i;
+  for(i=0;i<r->n;i++)
+    free(r->text[i]);
+  free(r->seeds);
+  free(r->x);
+  free(r->lambda);
+  free(r->text);
+  free(r);
+}
@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Adaptive parameter refinement: inserts parameters where the linear
+// interpolation of the solved eigenvalues is not accurate enough
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_REFINE
+#define QEPPS_REFINE
+
+typedef struct
+{
+  double tol;              // Relative interpolation error allowed
+  double min_width;        // Intervals this narrow are not split
+  int capacity;            // Parameters solved at most (the seeds always are)
+  int modes;               // Eigenvalues recorded per parameter
+  int nseeds, next_seed;   // Parameters of the table, walked in value order
+  int *seeds;
+  int n;                   // Solved parameters, sorted by value
+  double *x;
+  double complex *lambda;  // modes eigenvalues per solved parameter, NAN when missing
+  char **text;             // Output of each (first rank only)
+  int last;                // Position of the parameter solved last
+  int inserted;            // Parameters added to the table
+} ParameterRefiner;
+
+/*!
+ *  Reads the refine_tolerance and refine_max_points options from the QEPPS options table in
+ *  the LUA state and returns NULL when refine_tolerance is not positive. The (real) values of
+ *  the parameters table become the seeds: all of them are solved, in increasing order, and
+ *  parameters are inserted between them. modes eigenvalues are recorded per parameter.
+ */
+ParameterRefiner *createParameterRefiner(int modes);
+
+/*!
+ *  Returns the index of the next parameter to solve, or -1 when the sweep is done. Intervals
+ *  behind the last seed solved whose interpolation error (estimated from the second divided
+ *  difference of neighbouring parameters) exceeds the tolerance are split at their midpoint,
+ *  nearest to the last solved parameter first, which is appended to the parameters table.
+ *  Otherwise the walk moves on to the next seed.
+ */
+int nextRefinedParameter(ParameterRefiner *r);
+
+/*!
+ *  Ends the output of parameter p, buffered since logBufferBegin() and held back until
+ *  writeRefinedSweep(). lambda holds the modes eigenvalues solved at p (NAN for a missing one).
+ */
+void endRefinedParameter(ParameterRefiner *r, int p, const double complex *lambda);
+
+/*!
+ *  Writes the output of all solved parameters sorted by parameter value
+ */
+void writeRefinedSweep(ParameterRefiner *r);
+
+void deleteParameterRefiner(ParameterRefiner *r);
+
+#endif
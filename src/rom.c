@@ -0,0 +1,361 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Reduced-order model: the components projected onto a basis of sampled
+// eigenvectors, solved as small dense QEPs in place of full solves
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include <grvy.h>
+#include "types.h"
+#include "assemble.h"
+#include "rom.h"
+#include "config.h"
+#include "log.h"
+
+// Part of a new eigenvector that must remain after orthogonalization to extend the basis
+#define ROM_DEFLATION_TOL 1e-8
+
+// First entry of a reduced model file
+#define ROM_FILE_ID 7102
+
+static void loadReducedModel(ReducedModel *rom)
+{
+  int j, i, c, num, max=rom->max;
+  PetscInt header[5];
+  PetscViewer viewer;
+
+  PetscViewerBinaryOpen(PETSC_COMM_WORLD,rom->file,FILE_MODE_READ,&viewer);
+  PetscViewerBinaryRead(viewer,header,5,PETSC_INT);
+  if( header[0]!=ROM_FILE_ID )
+    logError("#! '%s' is not a reduced model file\n",rom->file);
+  for(j=0;j<3;j++)
+    if( header[2+j]!=rom->M[j]->Mc->num )
+      logError("#! Reduced model '%s' does not match the components of '%s'\n",rom->file,rom->M[j]->name);
+  if( header[1]>max )
+    logError("#! Reduced model '%s' has %i basis vectors, rom_max_basis is %i\n",rom->file,(int)header[1],max);
+  rom->size = rom->projected = header[1];
+  for(j=0;j<3;j++)
+  {
+    num = rom->M[j]->Mc->num;
+    for(i=0;i<num;i++)
+      for(c=0;c<rom->size;c++)
+        PetscViewerBinaryRead(viewer,rom->R[j]+i*max*max+c*max,rom->size,PETSC_SCALAR);
+  }
+  for(c=0;c<rom->size;c++)
+    VecLoad(rom->V[c],viewer);
+  PetscViewerDestroy(&viewer);
+  logOutput("# reduced model of %i basis vectors loaded from %s\n",rom->size,rom->file);
+}
+
+ReducedModel *createReducedModel(MatrixAssembler *K, MatrixAssembler *D, MatrixAssembler *E, int nev)
+{
+  int j;
+  PetscBool exists;
+  double tol = creal(getOptComplexLUA("rom_tolerance",0));
+
+  if( tol<=0 )
+    return NULL;
+  ReducedModel *rom = malloc( sizeof(ReducedModel) );
+  if (rom==NULL)
+    logError("#! Allocation of the reduced model failed\n");
+  rom->M[0] = K;
+  rom->M[1] = D;
+  rom->M[2] = E;
+  rom->tol = tol;
+  rom->nev = nev>0 ? nev : 1;
+  rom->max = getOptIntLUA("rom_max_basis",100);
+  if( rom->max<rom->nev )
+    rom->max = rom->nev;
+  for(j=0;j<3;j++)
+  {
+    rom->R[j] = calloc( (size_t)rom->M[j]->Mc->num*rom->max*rom->max, sizeof(PetscScalar) );
+    rom->T[j] = malloc( sizeof(PetscScalar)*rom->max*rom->max );
+    if (rom->R[j]==NULL || rom->T[j]==NULL)
+      logError("#! Allocation of the reduced components of '%s' failed\n",rom->M[j]->name);
+  }
+  rom->lambda = malloc( sizeof(PetscScalar)*rom->nev );
+  rom->Y = malloc( sizeof(PetscScalar)*rom->nev*rom->max );
+  if (rom->lambda==NULL || rom->Y==NULL)
+    logError("#! Allocation of the reduced model failed\n");
+
+  MatGetVecs(E->M,&(rom->w[0]),NULL);
+  for(j=1;j<4;j++)
+    VecDuplicate(rom->w[0],&(rom->w[j]));
+  VecDuplicateVecs(rom->w[0],rom->max,&(rom->V));
+  DSCreate(PETSC_COMM_SELF,&(rom->ds));
+  DSSetType(rom->ds,DSGNHEP);
+  DSAllocate(rom->ds,2*rom->max);
+
+  rom->size = rom->projected = 0;
+  rom->nsolved = 0;
+  rom->worst = 0;
+  rom->reduced = rom->full = 0;
+  rom->file = getOptStringLUA("rom_file","");
+  if( rom->file[0]=='\0' )
+  {
+    free(rom->file);
+    rom->file = NULL;
+  }
+  else
+  {
+    PetscTestFile(rom->file,'r',&exists);
+    if( exists )
+      loadReducedModel(rom);
+  }
+  logOutput("# reduced model: residual tolerance %.1E, basis of up to %i vectors\n",rom->tol,rom->max);
+  return rom;
+}
+
+// Projects operator j onto the new basis vectors. Each component is put alone into the total
+// matrix in turn, the coefficients it held are put back at the end.
+static void projectOperator(ReducedModel *rom, int j)
+{
+  MatrixAssembler *A = rom->M[j];
+  int i, k, r, c, n0=rom->projected, n1=rom->size, num=A->Mc->num, max=rom->max;
+  PetscScalar saved[num], unit[num], dots[n1];
+  PetscScalar *R;
+
+  PetscMemcpy(saved,A->coef,sizeof(PetscScalar)*num);
+  for(i=0;i<num;i++)
+  {
+    for(k=0;k<num;k++)
+      unit[k] = k==i ? 1 : 0;
+    combineComponents(A,unit);
+    R = rom->R[j]+i*max*max;
+
+    // New columns against the whole basis
+    for(c=n0;c<n1;c++)
+    {
+      MatMult(A->M,rom->V[c],rom->w[0]);
+      VecMDot(rom->w[0],n1,rom->V,dots);
+      for(r=0;r<n1;r++)
+        R[c*max+r] = dots[r];
+    }
+    // New rows against the old columns, with M^H v = conj(M^T conj(v))
+    for(r=n0;r<n1 && n0>0;r++)
+    {
+      VecCopy(rom->V[r],rom->w[1]);
+      VecConjugate(rom->w[1]);
+      MatMultTranspose(A->M,rom->w[1],rom->w[0]);
+      VecConjugate(rom->w[0]);
+      VecMDot(rom->w[0],n0,rom->V,dots);
+      for(c=0;c<n0;c++)
+        R[c*max+r] = PetscConj(dots[c]);
+    }
+  }
+  combineComponents(A,saved);
+}
+
+void addBasisVector(ReducedModel *rom, Vec U)
+{
+  int i, k, n=rom->size;
+  PetscScalar dots[n>0 ? n : 1];
+  PetscReal norm0, norm;
+
+  if( n==rom->max )
+    return;
+  VecCopy(U,rom->V[n]);
+  VecNorm(rom->V[n],NORM_2,&norm0);
+  if( norm0==0 )
+    return;
+  // Classical Gram-Schmidt, twice for orthogonality to working precision
+  for(k=0;k<2 && n>0;k++)
+  {
+    VecMDot(rom->V[n],n,rom->V,dots);
+    for(i=0;i<n;i++)
+      dots[i] = -dots[i];
+    VecMAXPY(rom->V[n],n,dots,rom->V);
+  }
+  VecNorm(rom->V[n],NORM_2,&norm);
+  if( norm<=ROM_DEFLATION_TOL*norm0 )
+    return;
+  VecScale(rom->V[n],1/norm);
+  rom->size++;
+}
+
+void projectBasis(ReducedModel *rom)
+{
+  int j;
+  if( rom->projected==rom->size )
+    return;
+  grvy_timer_begin("reduce");
+  for(j=0;j<3;j++)
+    projectOperator(rom,j);
+  rom->projected = rom->size;
+  grvy_timer_end("reduce");
+}
+
+// Operator j at the coefficients its assembler holds, n x n with leading dimension max
+static void combineReduced(ReducedModel *rom, int j)
+{
+  MatrixAssembler *A = rom->M[j];
+  int i, k, n=rom->projected, max=rom->max;
+  PetscScalar *R;
+
+  for(k=0;k<n*max;k++)
+    rom->T[j][k] = 0;
+  for(i=0;i<A->Mc->num;i++)
+  {
+    if( A->coef[i]==0 )
+      continue;
+    R = rom->R[j]+i*max*max;
+    for(k=0;k<n*max;k++)
+      rom->T[j][k] += A->coef[i]*R[k];
+  }
+}
+
+bool solveReducedModel(ReducedModel *rom, PetscScalar target)
+{
+  int j, i, k, r, c, n=rom->projected, max=rom->max, best;
+  PetscInt ld;
+  PetscScalar *a, *b, *x, l, eig[2*max], eigi[2*max];
+  PetscReal norm[4], estimate;
+  bool taken[2*max];
+
+  rom->nsolved = 0;
+  rom->worst = 0;
+  if( n<rom->nev )
+  {
+    rom->full++;
+    return false;
+  }
+  grvy_timer_begin("reduce");
+  for(j=0;j<3;j++)
+    combineReduced(rom,j);
+
+  // Linearization [0 I; -K -D] z = lambda [I 0; 0 E] z with z = [y; lambda*y]
+  DSSetDimensions(rom->ds,2*n,0,0,0);
+  DSGetLeadingDimension(rom->ds,&ld);
+  DSGetArray(rom->ds,DS_MAT_A,&a);
+  DSGetArray(rom->ds,DS_MAT_B,&b);
+  for(c=0;c<2*n;c++)
+    for(r=0;r<2*n;r++)
+      a[c*ld+r] = b[c*ld+r] = 0;
+  for(c=0;c<n;c++)
+  {
+    a[(n+c)*ld+c] = 1;
+    b[c*ld+c] = 1;
+    for(r=0;r<n;r++)
+    {
+      a[c*ld+n+r] = -rom->T[0][c*max+r];
+      a[(n+c)*ld+n+r] = -rom->T[1][c*max+r];
+      b[(n+c)*ld+n+r] = rom->T[2][c*max+r];
+    }
+  }
+  DSRestoreArray(rom->ds,DS_MAT_A,&a);
+  DSRestoreArray(rom->ds,DS_MAT_B,&b);
+  DSSetState(rom->ds,DS_STATE_RAW);
+  DSSolve(rom->ds,eig,eigi);
+  DSVectors(rom->ds,DS_MAT_X,NULL,NULL);
+
+  // The nev finite eigenvalues nearest the target
+  DSGetArray(rom->ds,DS_MAT_X,&x);
+  for(i=0;i<2*n;i++)
+    taken[i] = false;
+  for(k=0;k<rom->nev;k++)
+  {
+    best = -1;
+    for(i=0;i<2*n;i++)
+    {
+      if( taken[i] || !isfinite(cabs(TO_DOUBLE_COMPLEX(eig[i]))) )
+        continue;
+      if( best<0 || PetscAbsScalar(eig[i]-target)<PetscAbsScalar(eig[best]-target) )
+        best = i;
+    }
+    if( best<0 )
+      break;
+    taken[best] = true;
+    rom->lambda[k] = eig[best];
+    PetscMemcpy(rom->Y+k*max,x+best*ld,sizeof(PetscScalar)*n);
+    rom->nsolved++;
+  }
+  DSRestoreArray(rom->ds,DS_MAT_X,&x);
+
+  // Residuals of the lifted eigenpairs in the full problem
+  for(k=0;k<rom->nsolved;k++)
+  {
+    getReducedEigenpair(rom,k,&l,rom->w[3]);
+    for(j=0;j<3;j++)
+    {
+      MatMult(rom->M[j]->M,rom->w[3],rom->w[j]);
+      VecNorm(rom->w[j],NORM_2,&norm[j]);
+    }
+    VecAXPY(rom->w[0],l,rom->w[1]);
+    VecAXPY(rom->w[0],l*l,rom->w[2]);
+    VecNorm(rom->w[0],NORM_2,&norm[3]);
+    estimate = norm[3]/(norm[0]+PetscAbsScalar(l)*norm[1]+PetscAbsScalar(l)*PetscAbsScalar(l)*norm[2]);
+    if( estimate>rom->worst )
+      rom->worst = estimate;
+  }
+  grvy_timer_end("reduce");
+
+  if( rom->nsolved==rom->nev && rom->worst<=rom->tol )
+  {
+    rom->reduced++;
+    return true;
+  }
+  rom->full++;
+  return false;
+}
+
+void getReducedEigenpair(ReducedModel *rom, int k, PetscScalar *lambda, Vec U)
+{
+  *lambda = rom->lambda[k];
+  VecSet(U,0);
+  VecMAXPY(U,rom->projected,rom->Y+k*rom->max,rom->V);
+  VecNormalize(U,NULL);
+}
+
+void saveReducedModel(ReducedModel *rom)
+{
+  int j, i, c, max=rom->max;
+  PetscInt header[5];
+  PetscViewer viewer;
+
+  if( rom->file==NULL )
+    return;
+  header[0] = ROM_FILE_ID;
+  header[1] = rom->projected;
+  for(j=0;j<3;j++)
+    header[2+j] = rom->M[j]->Mc->num;
+  grvy_check_file_path(rom->file);
+  PetscViewerBinaryOpen(PETSC_COMM_WORLD,rom->file,FILE_MODE_WRITE,&viewer);
+  PetscViewerBinaryWrite(viewer,header,5,PETSC_INT,PETSC_FALSE);
+  for(j=0;j<3;j++)
+    for(i=0;i<rom->M[j]->Mc->num;i++)
+      for(c=0;c<rom->projected;c++)
+        PetscViewerBinaryWrite(viewer,rom->R[j]+i*max*max+c*max,rom->projected,PETSC_SCALAR,PETSC_FALSE);
+  for(c=0;c<rom->projected;c++)
+    VecView(rom->V[c],viewer);
+  PetscViewerDestroy(&viewer);
+  logOutput("# reduced model of %i basis vectors saved to %s\n",rom->projected,rom->file);
+}
+
+void deleteReducedModel(ReducedModel *rom)
+{
+  int j;
+  for(j=0;j<3;j++)
+  {
+    free(rom->R[j]);
+    free(rom->T[j]);
+  }
+  for(j=0;j<4;j++)
+    VecDestroy(&(rom->w[j]));
+  VecDestroyVecs(rom->max,&(rom->V));
+  DSDestroy(&(rom->ds));
+  free(rom->lambda);
+  free(rom->Y);
+  free(rom->file);
+  free(rom);
+}
@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Reduced-order model: the components projected onto a basis of sampled
+// eigenvectors, solved as small dense QEPs in place of full solves
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_ROM
+#define QEPPS_ROM
+
+typedef struct
+{
+  MatrixAssembler *M[3];   // Assemblers of the PEP operators (K, D, E)
+  double tol;              // Largest residual estimate a reduced eigenpair is accepted with
+  char *file;              // Reduced model saved/loaded here, NULL for none
+  int size, max;           // Basis vectors, room for them
+  int projected;           // Basis vectors the components are projected onto
+  Vec *V;                  // Orthonormal basis
+  PetscScalar *R[3];       // Reduced components, R[j][i*max*max+c*max+r] = V_r^H M_i V_c of operator j
+  PetscScalar *T[3];       // Reduced operators at the current coefficients
+  DS ds;                   // Dense solver of the linearized reduced problem
+  int nev;                 // Eigenpairs wanted per parameter
+  int nsolved;             // Eigenpairs of the last reduced solve
+  PetscScalar *lambda;     // Their eigenvalues
+  PetscScalar *Y;          // Their reduced eigenvectors, max entries each
+  PetscReal worst;         // Largest residual estimate of the last reduced solve
+  Vec w[4];                // Work vectors
+  int reduced, full;       // Parameters solved by the reduced and the full problem
+} ReducedModel;
+
+/*!
+ *  Reads the rom_tolerance, rom_max_basis, and rom_file options from the QEPPS options table
+ *  in the LUA state and returns NULL when rom_tolerance is not positive. The PEP operators are
+ *  the total matricies of K, D, and E (in that order), nev eigenpairs are wanted per
+ *  parameter. An existing rom_file is loaded as the starting basis.
+ */
+ReducedModel *createReducedModel(MatrixAssembler *K, MatrixAssembler *D, MatrixAssembler *E, int nev);
+
+/*!
+ *  Solves the reduced problem at the coefficients the assemblers currently hold, keeping the
+ *  nev eigenpairs nearest target. Each lifted eigenpair is checked by the relative residual
+ *  |(K + lambda*D + lambda^2*E)u| / (|Ku| + |lambda||Du| + |lambda|^2|Eu|) of the full
+ *  problem. Returns true when all nev eigenpairs estimate within the tolerance.
+ */
+bool solveReducedModel(ReducedModel *rom, PetscScalar target);
+
+/*!
+ *  Returns eigenpair k of the last reduced solve, U lifted to the full space
+ */
+void getReducedEigenpair(ReducedModel *rom, int k, PetscScalar *lambda, Vec U);
+
+/*!
+ *  Orthogonalizes U against the basis and appends it unless it is (nearly) contained.
+ *  projectBasis() then projects the components onto the new basis vectors.
+ */
+void addBasisVector(ReducedModel *rom, Vec U);
+void projectBasis(ReducedModel *rom);
+
+/*!
+ *  Writes the basis and the reduced components to rom_file (if set)
+ */
+void saveReducedModel(ReducedModel *rom);
+
+void deleteReducedModel(ReducedModel *rom);
+
+#endif
@@ -0,0 +1,181 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Detection of matricies whose components all scale as one monomial of the
+// parameter, and the eigenvalue rescaling that freezes them
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include <math.h>
+#include "types.h"
+#include "config.h"
+#include "separable.h"
+#include "log.h"
+
+// Highest monomial degree looked for in the scaling functions
+#define MAX_MONOMIAL_DEGREE 6
+
+// Relative tolerance on c(x)*x_ref^k = c(x_ref)*x^k for a monomial of degree k
+#define MONOMIAL_TOL 1e-10
+
+// Degree k of the single monomial all num scaling functions of the matrix follow, or -1
+static int monomialDegree(const char *name, int num, int ref)
+{
+  int n=getNumberOfParameters(), p, i, k;
+  double complex xr=getParameterValue(ref), lhs, rhs;
+  double complex *c = malloc( sizeof(double complex)*n*num );
+  bool monomial=false;
+
+  if (c==NULL)
+    logError("#! Allocation of the scaling function values of '%s' failed\n",name);
+  for(p=0;p<n;p++)
+    for(i=0;i<num;i++)
+      c[p*num+i] = funcParamValue(name,p,i);
+
+  for(k=0;k<=MAX_MONOMIAL_DEGREE && !monomial;k++)
+  {
+    monomial = true;
+    for(p=0;p<n && monomial;p++)
+      for(i=0;i<num && monomial;i++)
+      {
+        lhs = c[p*num+i]*cpow(xr,k);
+        rhs = c[ref*num+i]*cpow(getParameterValue(p),k);
+        if( cabs(lhs-rhs) > MONOMIAL_TOL*fmax(cabs(lhs),cabs(rhs)) )
+          monomial = false;
+      }
+  }
+  free(c);
+  return monomial ? k-1 : -1;
+}
+
+// Non-integer powers need positive real parameters, negative ones need non-zero parameters
+static bool isValidScaling(double t, double a)
+{
+  int p, j;
+  double complex x;
+  bool integer = t==floor(t) && a==floor(a);
+
+  for(p=0;p<getNumberOfParameters();p++)
+  {
+    x = getParameterValue(p);
+    if( !integer && (cimag(x)!=0 || creal(x)<=0) )
+      return false;
+    if( x==0 && t<0 )
+      return false;
+    for(j=0;j<3;j++)
+      if( x==0 && j*t+a<0 )
+        return false;
+  }
+  return true;
+}
+
+static int countFrozen(const int degree[3], double t, double a)
+{
+  int j, n=0;
+  for(j=0;j<3;j++)
+    if( degree[j]>=0 && fabs(j*t+degree[j]+a)<1e-12 )
+      n++;
+  return n;
+}
+
+// Keeps (t,a) when it freezes more matricies than the best so far, or as many with a smaller
+// rescaling
+static void tryScaling(const int degree[3], double t, double a, double *t_best, double *a_best, int *n_best)
+{
+  int n = countFrozen(degree,t,a);
+  if( !isValidScaling(t,a) )
+    return;
+  if( n>*n_best || (n==*n_best && fabs(t)+fabs(a) < fabs(*t_best)+fabs(*a_best)) )
+  {
+    *t_best = t;
+    *a_best = a;
+    *n_best = n;
+  }
+}
+
+void detectSeparableForm(const char *names[3], const int num[3], ParameterScaling *s)
+{
+  int j, i, p, n_base, n_best, ref=0;
+  double t=0, a=0;
+
+  s->active = false;
+  s->t = s->a = 0;
+  s->p_ref = 0;
+  for(j=0;j<3;j++)
+  {
+    s->degree[j] = -1;
+    s->frozen[j] = false;
+  }
+  if( getNumberOfParameters()<2 )
+    return;
+
+  // Reference at the largest parameter magnitude
+  for(p=1;p<getNumberOfParameters();p++)
+    if( cabs(getParameterValue(p)) > cabs(getParameterValue(ref)) )
+      ref = p;
+  if( getParameterValue(ref)==0 )
+    return;
+  s->p_ref = ref;
+
+  for(j=0;j<3;j++)
+  {
+    s->degree[j] = monomialDegree(names[j],num[j],ref);
+    if( s->degree[j]>=0 )
+      logOutput("# matrix %s scales as x^%i\n",names[j],s->degree[j]);
+    else
+      logOutput("# matrix %s is not a single monomial of the parameter\n",names[j]);
+  }
+
+  // Every pair of monomial matricies fixes t and a, a single one fixes either of them
+  n_base = n_best = countFrozen(s->degree,0,0);
+  for(j=0;j<3;j++)
+  {
+    if( s->degree[j]<0 ) continue;
+    tryScaling(s->degree,0,-s->degree[j],&t,&a,&n_best);
+    if( j>0 )
+      tryScaling(s->degree,-(double)s->degree[j]/j,0,&t,&a,&n_best);
+    for(i=0;i<j;i++)
+      if( s->degree[i]>=0 )
+      {
+        double ti = (double)(s->degree[j]-s->degree[i])/(i-j);
+        tryScaling(s->degree,ti,-s->degree[i]-i*ti,&t,&a,&n_best);
+      }
+  }
+
+  if( n_best>n_base )
+  {
+    s->active = true;
+    s->t = t;
+    s->a = a;
+    for(j=0;j<3;j++)
+      s->frozen[j] = s->degree[j]>=0 && fabs(j*t+s->degree[j]+a)<1e-12;
+    logOutput("# separable form: lambda = mu*x^%g, problem scaled by x^%g, %i of 3 matricies constant (was %i)\n",
+              t,a,n_best,n_base);
+  }
+  else
+    logOutput("# separable form: no rescaling keeps more matricies constant\n");
+}
+
+double complex unscaleEigenvalue(const ParameterScaling *s, int p, double complex mu)
+{
+  if( !s->active || s->t==0 )
+    return mu;
+  return mu*cpow(getParameterValue(p),s->t);
+}
+
+double complex scaleEigenvalue(const ParameterScaling *s, int p, double complex lambda)
+{
+  if( !s->active || s->t==0 )
+    return lambda;
+  return lambda*cpow(getParameterValue(p),-s->t);
+}
@@ -0,0 +1,53 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Detection of matricies whose components all scale as one monomial of the
+// parameter, and the eigenvalue rescaling that freezes them
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_SEPARABLE
+#define QEPPS_SEPARABLE
+
+/*!
+ *  With lambda = mu*x^t and the whole problem multiplied by x^a, the matrix paired with
+ *  lambda^j has its coefficients multiplied by x^(j*t+a). Matricies that scale as x^k with
+ *  j*t+k+a = 0 no longer depend on the parameter x.
+ */
+typedef struct
+{
+  bool active;             // A rescaling (t or a non-zero) is applied
+  int degree[3];           // Monomial degree of K, D, and E (index j), -1 when not a single monomial
+  bool frozen[3];          // The rescaled matrix is constant over the sweep
+  double t, a;
+  int p_ref;               // Parameter index the frozen matricies are evaluated at
+} ParameterScaling;
+
+/*!
+ *  Evaluates the scaling functions of the matricies in names (K, D, E order, with num[j]
+ *  components each) on every parameter value, finds the monomial degree of each matrix, and
+ *  picks the t and a that make the most matricies constant. s->active is false when no choice
+ *  freezes more matricies than the unscaled problem. The outcome is logged.
+ */
+void detectSeparableForm(const char *names[3], const int num[3], ParameterScaling *s);
+
+/*!
+ *  Converts an eigenvalue mu of the rescaled problem at the p-th parameter value to lambda.
+ */
+double complex unscaleEigenvalue(const ParameterScaling *s, int p, double complex mu);
+
+/*!
+ *  Converts an eigenvalue lambda to mu of the rescaled problem at the p-th parameter value.
+ */
+double complex scaleEigenvalue(const ParameterScaling *s, int p, double complex lambda);
+
+#endif
@@ -0,0 +1,185 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Spectrum slicing: rank groups solving every parameter around different
+// targets, their eigenvalues merged into one line
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "config.h"
+#include "slice.h"
+#include "log.h"
+
+// Read once, it is needed before PETSc is initialized and again by the farm and the sweeper
+static int slice_count=0;
+
+int getSliceCount(void)
+{
+  int n;
+
+  if(slice_count>0)
+    return slice_count;
+  n = getOptComplexListLUA("lambda_tgt",NULL,0);
+  if(n<=1)
+    n = getOptIntLUA("slices",1);
+  slice_count = n>1 ? n : 1;
+  return slice_count;
+}
+
+int sliceRanksPerGroup(void)
+{
+  int size, slices=getSliceCount();
+
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  if(getOptIntLUA("ranks_per_group",0)>0)
+    logError("#! Spectrum slicing gives every slice its own rank group, unset ranks_per_group\n");
+  if(size%slices!=0)
+    logError("#! Spectrum slicing needs a multiple of %i ranks (one group per slice), got %i\n",slices,size);
+  return size/slices;
+}
+
+// A list of targets as given, otherwise the centres of slices equal parts of the segment
+static void getSliceTargets(double complex *targets, int slices)
+{
+  int k;
+  double complex lower, upper;
+
+  if(getOptComplexListLUA("lambda_tgt",targets,slices)==slices)
+    return;
+  lower = getOptComplexLUA("slice_lower",0);
+  upper = getOptComplexLUA("slice_upper",0);
+  if(lower==upper)
+    logError("#! Spectrum slicing needs a list of targets in lambda_tgt or slice_lower != slice_upper\n");
+  for(k=0;k<slices;k++)
+    targets[k] = lower+(k+0.5)/slices*(upper-lower);
+}
+
+SpectrumSlicer *createSpectrumSlicer(int max)
+{
+  int slices=getSliceCount(), rank, size, k;
+  double complex targets[slices];
+
+  if(slices==1)
+    return NULL;
+  SpectrumSlicer *s = malloc( sizeof(SpectrumSlicer) );
+  if (s==NULL)
+    logError("#! Allocation of the spectrum slicer failed\n");
+  getSliceTargets(targets,slices);
+  s->slices = slices;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(PETSC_COMM_WORLD,&size);
+  s->slice = rank/size;
+  s->target = targets[s->slice];
+  MPI_Comm_rank(PETSC_COMM_WORLD,&rank);
+  s->root = rank==0;
+  s->tol = creal(getOptComplexLUA("slice_tolerance",1e-6));
+  s->n = 0;
+  s->max = max;
+  s->lambda = malloc( max*sizeof(double complex) );
+  s->counts = NULL;
+  s->displs = NULL;
+  s->merged = NULL;
+  s->nmerged = 0;
+  s->total = 0;
+  s->duplicates = 0;
+  if (s->lambda==NULL)
+    logError("#! Allocation of the spectrum slicer failed\n");
+
+  // Every rank sends a count, only the group roots send eigenvalues
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  if(rank==0) {
+    s->counts = malloc( size*sizeof(int) );
+    s->displs = malloc( size*sizeof(int) );
+    s->merged = malloc( slices*max*sizeof(double complex) );
+    if (s->counts==NULL || s->displs==NULL || s->merged==NULL)
+      logError("#! Allocation of the spectrum slicer failed\n");
+  }
+  logOutput("# spectrum slicing: %i slices of %i ranks, duplicates within a relative %.1E merged\n",
+            slices,size/slices,s->tol);
+  for(k=0;k<slices;k++)
+    logOutput("# slice %i: target %.3f%+.3fj\n",k,creal(targets[k]),cimag(targets[k]));
+  return s;
+}
+
+void beginSlice(SpectrumSlicer *s)
+{
+  s->n = 0;
+}
+
+void addSliceEigenvalue(SpectrumSlicer *s, double complex lambda)
+{
+  if(s->n<s->max)
+    s->lambda[s->n++] = lambda;
+}
+
+static int compareEigenvalues(const void *a, const void *b)
+{
+  double complex x = *(const double complex*)a, y = *(const double complex*)b;
+  if(creal(x)!=creal(y))
+    return creal(x)<creal(y) ? -1 : 1;
+  if(cimag(x)!=cimag(y))
+    return cimag(x)<cimag(y) ? -1 : 1;
+  return 0;
+}
+
+// Whether lambda is within the tolerance of one of the merged eigenvalues kept so far
+static bool isMerged(SpectrumSlicer *s, double complex lambda)
+{
+  int i;
+  for(i=0;i<s->nmerged;i++)
+    if(cabs(lambda-s->merged[i]) <= s->tol*fmax(cabs(lambda),cabs(s->merged[i])))
+      return true;
+  return false;
+}
+
+void mergeSlices(SpectrumSlicer *s)
+{
+  int rank, size, i, n = s->root ? s->n : 0;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Comm_size(MPI_COMM_WORLD,&size);
+  MPI_Gather(&n,1,MPI_INT,s->counts,1,MPI_INT,0,MPI_COMM_WORLD);
+  if(rank==0) {
+    s->total = 0;
+    for(i=0;i<size;i++)
+    {
+      s->displs[i] = s->total;
+      s->total += s->counts[i];
+    }
+  }
+  MPI_Gatherv(s->lambda,n,MPI_C_DOUBLE_COMPLEX,s->merged,s->counts,s->displs,MPI_C_DOUBLE_COMPLEX,0,MPI_COMM_WORLD);
+  if(rank!=0)
+    return;
+
+  // Sorted, the copy kept of a duplicate is the first one
+  qsort(s->merged,s->total,sizeof(double complex),compareEigenvalues);
+  s->nmerged = 0;
+  for(i=0;i<s->total;i++)
+  {
+    if(isMerged(s,s->merged[i]))
+      continue;
+    s->merged[s->nmerged++] = s->merged[i];
+  }
+  s->duplicates += s->total-s->nmerged;
+}
+
+void deleteSpectrumSlicer(SpectrumSlicer *s)
+{
+  free(s->lambda);
+  free(s->counts);
+  free(s->displs);
+  free(s->merged);
+  free(s);
+}
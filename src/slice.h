@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Spectrum slicing: rank groups solving every parameter around different
+// targets, their eigenvalues merged into one line
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_SLICE
+#define QEPPS_SLICE
+
+typedef struct
+{
+  int slices;              // Number of targets, one rank group each
+  int slice;               // Slice of this rank's group
+  bool root;               // First rank of its group
+  double complex target;   // Target of this slice
+  double tol;              // Relative distance two eigenvalues are the same one within
+  int n, max;              // Eigenvalues of this slice at the current parameter, room for them
+  double complex *lambda;
+  int *counts, *displs;    // Eigenvalues of each slice (first rank of MPI_COMM_WORLD only)
+  double complex *merged;  // Merged and deduplicated eigenvalues (first rank only)
+  int nmerged, total;      // Their number, eigenvalues before deduplication
+  int duplicates;          // Duplicates removed over the sweep
+} SpectrumSlicer;
+
+/*!
+ *  Returns the number of slices from the QEPPS options table in the LUA state: the length of
+ *  lambda_tgt when it is a list of targets, otherwise slices (targets spread along the segment
+ *  from slice_lower to slice_upper). 1 when the spectrum is not sliced.
+ */
+int getSliceCount(void);
+
+/*!
+ *  Returns the ranks per group that gives every slice its own group, with the number of ranks
+ *  of MPI_COMM_WORLD a multiple of the number of slices. Must be called after MPI_Init().
+ */
+int sliceRanksPerGroup(void);
+
+/*!
+ *  Sets up the slice of the calling rank's group, keeping at most max eigenvalues per parameter.
+ *  Returns NULL when the spectrum is not sliced.
+ */
+SpectrumSlicer *createSpectrumSlicer(int max);
+
+/*!
+ *  Bracket the eigenvalues of one parameter: addSliceEigenvalue() records one of this slice,
+ *  mergeSlices() gathers those of all slices on the first rank of MPI_COMM_WORLD, sorted by
+ *  real part with duplicates (found by neighbouring slices) removed. Collective over
+ *  MPI_COMM_WORLD.
+ */
+void beginSlice(SpectrumSlicer *s);
+void addSliceEigenvalue(SpectrumSlicer *s, double complex lambda);
+void mergeSlices(SpectrumSlicer *s);
+
+void deleteSpectrumSlicer(SpectrumSlicer *s);
+
+#endif
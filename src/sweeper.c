@@ -20,37 +20,44 @@
 #include "types.h"
 #include "luavars.h"
 #include "config.h"
+#include "assemble.h"
+#include "separable.h"
+#include "lowrank.h"
+#include "condense.h"
+#include "factor.h"
+#include "inner.h"
+#include "farm.h"
+#include "predictor.h"
+#include "warmstart.h"
+#include "track.h"
+#include "refine.h"
+#include "rom.h"
+#include "contour.h"
+#include "slice.h"
+#include "newton.h"
 #include "log.h"
 
-static void assembleMatrix(const char* matrix_name, Mat M, MatrixComponent *Mc, int p)
-{
-  int i;
-  double complex value;
-  
-  MatZeroEntries(M);
-  
-  for(i=0;i<Mc->num;i++)
-  {
-    value=funcParamValue(matrix_name,p,i);
-    MatAXPY( M, TO_PETSC_COMPLEX(value), Mc->matrix[i], DIFFERENT_NONZERO_PATTERN );
-  }
-  
-  MatAssemblyBegin(M,MAT_FINAL_ASSEMBLY);
-  MatAssemblyEnd(M,MAT_FINAL_ASSEMBLY);  
-}
+static const char *assembly_status[] = {"skipped","delta","full"};
 
 void qeppsSweeper(void)
 {
   PEP pep;  
   ST st;     
-  Vec Uout, Uinit;
+  KSP ksp;
+  PC pc;
+  Vec Uout;
   Mat E, D, K, A[3];
   PetscComplex lambda_solved;
   PetscReal    error, tol;
   PetscInt     i, ev, nConverged, maxIterations, nIterations;
   PetscViewer  viewer;
-  int p;
-  double complex lambda_tgt;
+  int p, p_prev, nev;
+  double complex lambda, lambda_lead, lambda_tgt, lambda_tgt_init, target, target_set;
+  AssemblyStatus status[3];
+  bool print_timing, symmetric, padded, field_blocks, refactor, lead, rom_solved, newton_tried, newton_solved, contoured;
+  int rebuilt[3][3], factored[3]={0,0,0}, predictions, total_iterations=0, solved=0, lost_modes=0, rom_counts[3]={0,0,0}, slice_duplicates=0, newton_counts[2]={0,0}, inner_counts[2]={0,0}, lowrank_updates=0, condensed_complements=0;
+  double prediction_error[2];
+  const char *factor_state;
   
   grvy_timer_init("qepps_parameter_sweep");
   grvy_timer_begin("setup");
@@ -60,23 +67,82 @@ void qeppsSweeper(void)
   MatrixComponent *Dc = parseConfigMatrixLUA(LUA_key_matrix_D);
   MatrixComponent *Kc = parseConfigMatrixLUA(LUA_key_matrix_K);
   
-  // Initialize total matricies
+  // Build the union nonzero pattern of each total matrix and the index maps of its components
   // (we scale/sum the component matricies from the previous step into these)
-  MatCreate(PETSC_COMM_WORLD,&E);
-  MatCreate(PETSC_COMM_WORLD,&D);
-  MatCreate(PETSC_COMM_WORLD,&K);
-  MatSetType(E,MATMPIAIJ);
-  MatSetType(D,MATMPIAIJ);
-  MatSetType(K,MATMPIAIJ);
-  
-  // Prime the total matricies with the problem size and nonzero pattern
-  MatDuplicate(Ec->matrix[0],MAT_SHARE_NONZERO_PATTERN,&E);
-  MatDuplicate(Dc->matrix[0],MAT_SHARE_NONZERO_PATTERN,&D);
-  MatDuplicate(Kc->matrix[0],MAT_SHARE_NONZERO_PATTERN,&K);
-  
-  // Get the target eigenvalue from the LUA state
-  lambda_tgt = getOptComplexLUA("lambda_tgt",1);
+  AssemblyOptions assembly_opts;
+  MatrixAssembler *Ea, *Da, *Ka;
+  getAssemblyOptionsLUA(&assembly_opts);
+  symmetric = Ec->symmetric && Dc->symmetric && Kc->symmetric && !assembly_opts.matrix_free;
+  if( !symmetric && (Ec->symmetric || Dc->symmetric || Kc->symmetric) )
+    logOutput("# symmetric_storage requested but not all components are symmetric, using general storage\n");
+  padded = symmetric || assembly_opts.blocked;
+  field_blocks = !assembly_opts.matrix_free && innerFieldBlocks();
+  if( padded || field_blocks )
+  {
+    // Blocked and/or upper triangular storage, the totals on one pattern shared by E, D, and K.
+    // The block size of a node for the inner preconditioner is detected on it as well.
+    MatrixComponent *all[3] = {Ec,Dc,Kc};
+    Mat pattern = createSharedPattern(all,3);
+    PetscInt bs = 1;
+    if( assembly_opts.blocked || field_blocks )
+      bs = detectBlockSize(pattern,assembly_opts.block_size);
+    padded = symmetric || (assembly_opts.blocked && bs > 1);
+    if( !padded )
+      assembly_opts.field_block_size = bs;
+    if( padded && (assembly_opts.stacked || assembly_opts.real) )
+      logOutput("# stacked_components and real_components are ignored with symmetric or block storage\n");
+    if( padded )
+    {
+      Ea = createPaddedAssembler(LUA_key_matrix_E,Ec,pattern,symmetric,bs);
+      Da = createPaddedAssembler(LUA_key_matrix_D,Dc,pattern,symmetric,bs);
+      Ka = createPaddedAssembler(LUA_key_matrix_K,Kc,pattern,symmetric,bs);
+    }
+    MatDestroy(&pattern);
+  }
+  if( !padded )
+  {
+    Ea = createAssembler(LUA_key_matrix_E,Ec,&assembly_opts);
+    Da = createAssembler(LUA_key_matrix_D,Dc,&assembly_opts);
+    Ka = createAssembler(LUA_key_matrix_K,Kc,&assembly_opts);
+  }
+  E=Ea->M; D=Da->M; K=Ka->M;
+  
+  // Rescale the eigenvalue so that matricies following a single monomial of the parameter
+  // become constant (solved for mu, with lambda = mu*x^t)
+  ParameterScaling scaling = {false};
+  if( getOptBooleanLUA("separable_rescaling",false) && creal(getOptComplexLUA("refine_tolerance",0))>0 )
+  {
+    // The form is detected on the parameters of the table, refinement inserts others (where
+    // a negative exponent may not even be defined)
+    logOutput("# separable_rescaling is ignored with refine_tolerance, inserted parameters are not covered by the detected form\n");
+  }
+  else if( getOptBooleanLUA("separable_rescaling",false) )
+  {
+    const char *names[3] = {LUA_key_matrix_K,LUA_key_matrix_D,LUA_key_matrix_E};
+    int num[3] = {Kc->num,Dc->num,Ec->num};
+    MatrixAssembler *Aj[3] = {Ka,Da,Ea};
+    detectSeparableForm(names,num,&scaling);
+    for(p=0; p<3 && scaling.active; p++)
+      setAssemblerScaling(Aj[p],p*scaling.t+scaling.a,scaling.frozen[p] ? scaling.p_ref : -1);
+    if( scaling.active && scaling.t!=0 )
+      logOutput("# separable form: the scaled target changes with the parameter, so every parameter refactors (no solver or factor reuse at a fixed shift)\n");
+  }
+  
+  // Optionally compare the fused assembly kernel against a chain of MatAXPY calls
+  if( getOptIntLUA("benchmark_assembly",0) > 0 )
+  {
+    benchmarkAssembly(Ea,getOptIntLUA("benchmark_assembly",0));
+    benchmarkAssembly(Da,getOptIntLUA("benchmark_assembly",0));
+    benchmarkAssembly(Ka,getOptIntLUA("benchmark_assembly",0));
+  }
+  
+  // Get the target eigenvalue from the LUA state, the target of this group's slice when the
+  // spectrum is sliced
+  SpectrumSlicer *slicer = createSpectrumSlicer(2*getOptIntLUA("nev",1));
+  lambda_tgt = slicer!=NULL ? slicer->target : getOptComplexLUA("lambda_tgt",1);
+  lambda_tgt_init = lambda_tgt;
   logOutput("# lambda_tgt set to %.3f%+.3fj\n",creal(lambda_tgt),cimag(lambda_tgt));
+  target_set = lambda_tgt;
   
   // Initialize the solver
   A[0]=K; A[1]=D; A[2]=E;
@@ -85,57 +151,351 @@ void qeppsSweeper(void)
   PEPGetST(pep,&st);
   STSetTransform(st,1);
   STSetType(st,STSINVERT);
-  PEPSetDimensions(pep,getOptIntLUA("nev",1),2*getOptIntLUA("nev",1),getOptIntLUA("nev",1));
+  if( assembly_opts.matrix_free )
+  {
+    // No explicit shifted matrix can be formed (or factored) from shell operators, default to
+    // an iterative inner solve that only needs products and the diagonal
+    STSetMatMode(st,ST_MATMODE_SHELL);
+    STGetKSP(st,&ksp);
+    KSPSetType(ksp,KSPGMRES);
+    KSPGetPC(ksp,&pc);
+    PCSetType(pc,PCJACOBI);
+    logOutput("# matrix-free operators: spectral transform uses a shell matrix and an iterative inner solve\n");
+  }
+  // Tracking asks for exactly the tracked modes
+  nev = getOptIntLUA("track_modes",0)>0 ? getOptIntLUA("track_modes",0) : getOptIntLUA("nev",1);
+  PEPSetDimensions(pep,nev,2*nev,nev);
+  if( padded )
+    STSetMatStructure(st,SAME_NONZERO_PATTERN);
   PEPSetFromOptions(pep);
+  if( symmetric )
+  {
+    // Only the upper triangles are stored, so an LU request becomes a (complex symmetric) LDL^T
+    PCType pc_type;
+    STGetKSP(st,&ksp);
+    KSPGetPC(ksp,&pc);
+    PCGetType(pc,&pc_type);
+    if( pc_type!=NULL && strcmp(pc_type,PCLU)==0 )
+    {
+      PCSetType(pc,PCCHOLESKY);
+      logOutput("# symmetric storage: st_pc_type lu replaced by cholesky\n");
+    }
+  }
+  
+  // An iterative inner solve from the options table replaces the one of the command line, for
+  // shifted matricies whose factors do not fit in memory
+  InnerSolver *inner = createInnerSolver(pep,K,D,E,assembly_opts.matrix_free);
+  
+  // With a direct inner solve the shifted matrix is factored here instead of by the spectral
+  // transform, so that its ordering and symbolic analysis are done once for the whole sweep
+  ShiftedFactor *factor = NULL;
+  char *predictor_type = getOptStringLUA("predictor","none");
+  bool moving_shift = getOptBooleanLUA("update_lambda_tgt",false) || strcmp(predictor_type,"none")!=0 || (scaling.active && scaling.t!=0);
+  free(predictor_type);
+  if( getOptBooleanLUA("reuse_analysis",false) && !assembly_opts.matrix_free )
+  {
+    PCType pc_type;
+    MatSolverPackage package;
+    PEPScale scale;
+    STGetKSP(st,&ksp);
+    KSPGetPC(ksp,&pc);
+    PCGetType(pc,&pc_type);
+    PEPGetScale(pep,&scale,NULL,NULL,NULL,NULL,NULL);
+    if( pc_type!=NULL && (strcmp(pc_type,PCLU)==0 || strcmp(pc_type,PCCHOLESKY)==0) )
+    {
+      if( scale!=PEP_SCALE_NONE )
+        logOutput("# reuse_analysis is ignored with pep_scale, the spectral transform factors the scaled matrix\n");
+      else
+      {
+        PCFactorGetMatSolverPackage(pc,&package);
+        factor = createShiftedFactor(K,D,E,padded,strcmp(pc_type,PCCHOLESKY)==0,package!=NULL ? package : MATSOLVERPETSC);
+        attachShiftedFactor(factor,st);
+        logOutput("# shifted matrix factored with %s, ordering and symbolic analysis done once\n",factor->package);
+        if( getOptBooleanLUA("stale_factor",false) )
+        {
+          setStaleFactor(factor,st,getOptIntLUA("refactor_iterations",10));
+          logOutput("# stale factor: kept as gmres preconditioner, renewed beyond %i inner iterations per solve\n",factor->max_its);
+        }
+        if( getOptIntLUA("lowrank_max_rank",0)>0 )
+        {
+          setLowRankUpdates(factor,getOptIntLUA("lowrank_max_rank",0));
+          logOutput("# low-rank updates: at an unchanged shift, changes on up to %i rows update the factor\n",factor->lowrank->max_rank);
+          reportLowRankComponents(Ka,factor->lowrank->max_rank);
+          reportLowRankComponents(Da,factor->lowrank->max_rank);
+          reportLowRankComponents(Ea,factor->lowrank->max_rank);
+          if( moving_shift )
+            logOutput("# low-rank updates: the shift changes every parameter (update_lambda_tgt, predictor, or separable rescaling), so every parameter still refactors\n");
+        }
+        if( getOptBooleanLUA("relaxed_factor",false) )
+        {
+          if( setRelaxedFactor(factor,st,getOptIntLUA("refactor_iterations",10)) )
+            logOutput("# relaxed factor: static pivoting, corrected by gmres, exact again beyond %i inner iterations per solve\n",factor->max_its);
+          else
+            logOutput("# relaxed_factor needs mumps, the factor stays exact\n");
+        }
+        if( getOptIntLUA("condense_max_interface",0)>0 )
+        {
+          // Rows that only constant components touch are eliminated once per shift, each
+          // parameter then factors the Schur complement of the remaining interface
+          Vec mark;
+          int varying;
+          if( padded || factor->stale || factor->relaxed || factor->lowrank!=NULL )
+            logError("#! condense_max_interface needs the default (AIJ) storage and an exact factor (no stale_factor, relaxed_factor, or lowrank_max_rank)\n");
+          if( creal(getOptComplexLUA("refine_tolerance",0))>0 )
+            logError("#! condense_max_interface classifies the rows on the parameters of the table, it does not combine with refine_tolerance\n");
+          MatGetVecs(K,&mark,NULL);
+          VecSet(mark,0);
+          varying = markVaryingRows(Ka,mark) + markVaryingRows(Da,mark) + markVaryingRows(Ea,mark);
+          if( setCondensation(factor,mark,getOptIntLUA("condense_max_interface",0)) )
+            logOutput("# condensed factor: %i parameter-dependent components touch %i rows, the rest is factored once per shift\n",varying,factor->condensed->size);
+          else
+            logOutput("# condense_max_interface: the %i parameter-dependent components touch no rows or too many, the factor is not condensed\n",varying);
+          VecDestroy(&mark);
+        }
+      }
+    }
+  }
+  if( factor==NULL && (getOptBooleanLUA("stale_factor",false) || getOptBooleanLUA("relaxed_factor",false) ||
+                       getOptIntLUA("lowrank_max_rank",0)>0 || getOptIntLUA("condense_max_interface",0)>0) )
+    logOutput("# stale_factor, relaxed_factor, lowrank_max_rank, and condense_max_interface need reuse_analysis with a direct st_pc_type, ignored\n");
+  
+  print_timing = getOptBooleanLUA("print_timing",false);
   
   MPI_Comm_size(PETSC_COMM_WORLD,&p); 
   logOutput("# MPI_Comm_size = %i \n", p);
   logOutput("# Number of parameters = %i \n", getNumberOfParameters());
   grvy_timer_end("setup");
-  for (p=0; p < getNumberOfParameters(); p++)
+  // Parameters come in contiguous chunks, all of them in order unless split into a farm
+  ParameterFarm *farm = createParameterFarm();
+  EigenvaluePredictor *predictor = createPredictor();
+  
+  // Vectors are allocated once, the warm start keeps the converged eigenvectors of the last two
+  // parameters for the next initial space
+  WarmStart *warm = NULL;
+  MatGetVecs(E,&Uout,NULL);
+  if( getOptBooleanLUA("update_initspace", false) )
+    warm = createWarmStart(E,nev,getOptBooleanLUA("extrapolate_initspace",false));
+  ModeTracker *tracker = NULL;
+  if( getOptIntLUA("track_modes",0)>0 )
+  {
+    tracker = createModeTracker(E,nev,2*nev);
+    logOutput("# tracking %i modes: eigenvalue columns follow the modes, nan where a mode is lost\n",nev);
+  }
+  
+  // A reduced model built from sampled eigenvectors stands in for full solves where it is accurate
+  ReducedModel *rom = createReducedModel(Ka,Da,Ea,nev);
+  
+  // A region given for the eigenvalues replaces the shift-and-invert solves by contour integrals
+  ContourSolver *contour = createContourSolver();
+  contoured = contour!=NULL;
+  if( contour!=NULL && assembly_opts.matrix_free )
+    logError("#! The contour solver factors the shifted matrix, it does not work matrix-free\n");
+  if( contour!=NULL && contour->groups>1 && padded )
+    logError("#! Copies for contour_groups need the default (AIJ) storage, unset symmetric_storage and block_storage\n");
+  
+  // Following a single mode, Rayleigh quotient iteration from the last eigenpair stands in for
+  // the Krylov solve for as long as it converges
+  NewtonSolver *newton = createNewtonSolver(E,symmetric);
+  if( newton!=NULL && (nev!=1 || factor==NULL || contour!=NULL) )
+    logError("#! newton_max_its refines a single mode (nev = 1) with the shifted factor (st_pc_type lu or cholesky, reuse_analysis, no pep_scale), without a contour region\n");
+  
+  // Adaptive refinement picks the parameters itself, interpolating the tracked modes (or the
+  // leading eigenvalue)
+  ParameterRefiner *refiner = createParameterRefiner(tracker!=NULL ? tracker->modes : 1);
+  double complex solved_values[refiner!=NULL ? refiner->modes : 1];
+  if( slicer!=NULL && (tracker!=NULL || contour!=NULL || refiner!=NULL) )
+    logError("#! Spectrum slicing merges the eigenvalues of all slices, it does not combine with track_modes, a contour region, or refine_tolerance\n");
+  if( refiner!=NULL && farm->groups>1 )
+    logError("#! Adaptive refinement (refine_tolerance) does not split into rank groups (ranks_per_group)\n");
+  p_prev = -1;
+  p = refiner!=NULL ? nextRefinedParameter(refiner) : nextParameter(farm,-1);
+  for (; p>=0; p = refiner!=NULL ? nextRefinedParameter(refiner) : nextParameter(farm,p))
   {
+    if( refiner!=NULL )
+      logBufferBegin();
+    else
+      beginParameter(farm);
     grvy_timer_begin("assemble");
-    logOutput("%E", getParameterValue(p) );
     
-    assembleMatrix(LUA_key_matrix_E,E,Ec,p);
-    assembleMatrix(LUA_key_matrix_D,D,Dc,p);
-    assembleMatrix(LUA_key_matrix_K,K,Kc,p);
+    // A new chunk elsewhere in the sweep starts over from the configured target, refinement
+    // always continues from a neighbour
+    if( refiner!=NULL ? p_prev<0 : p!=p_prev+1 )
+    {
+      lambda_tgt = lambda_tgt_init;
+      resetPredictor(predictor);
+      if( warm!=NULL )
+        resetWarmStart(warm);
+      if( tracker!=NULL )
+        resetModeTracker(tracker);
+      if( newton!=NULL )
+        resetNewtonSolver(newton);
+    }
+    p_prev = p;
     
-    MatGetVecs(E,&Uout,NULL);
-    MatGetVecs(E,&Uinit,NULL);
+    // Only matricies whose scaling coefficients changed are touched
+    status[0] = updateMatrix(Ea,p);
+    status[1] = updateMatrix(Da,p);
+    status[2] = updateMatrix(Ka,p);
+    if( print_timing )
+      logOutput("# assembly: E %s, D %s, K %s\n",assembly_status[status[0]],assembly_status[status[1]],assembly_status[status[2]]);
+    logOutput("%E", getParameterValue(p) );
     
-    PEPSetOperators(pep,3,A);
-    PEPSetTarget(pep,TO_PETSC_COMPLEX(lambda_tgt));
+    // An unchanged problem with an unchanged target keeps the solver (and its factorization) as is
+    lambda_tgt = predictEigenvalue(predictor,getParameterValue(p),lambda_tgt);
+    target = scaleEigenvalue(&scaling,p,lambda_tgt);
+    refactor = p==0 || status[0]!=ASSEMBLY_SKIPPED || status[1]!=ASSEMBLY_SKIPPED || status[2]!=ASSEMBLY_SKIPPED || target!=target_set;
+    if( refactor )
+    {
+      PEPSetOperators(pep,3,A);
+      PEPSetTarget(pep,TO_PETSC_COMPLEX(target));
+      target_set = target;
+    }
+    if( warm!=NULL )
+      setWarmStart(warm,pep,getParameterValue(p));
     grvy_timer_end("assemble");
     
-    grvy_timer_begin("solve");
-    PEPSolve(pep);
-    grvy_timer_end("solve");
+    // A reduced solve accurate enough for every wanted eigenpair stands in for the full solve
+    factor_state = "unchanged";
+    rom_solved = rom!=NULL && solveReducedModel(rom,TO_PETSC_COMPLEX(target));
+    newton_tried = !rom_solved && newton!=NULL && newton->known;
+    newton_solved = false;
+    if( newton_tried )
+    {
+      grvy_timer_begin("solve");
+      newton_solved = solveNewton(newton,factor,K,D,E,TO_PETSC_COMPLEX(target));
+      grvy_timer_end("solve");
+    }
+    if( rom_solved || newton_solved )
+    {
+      // Neither the solver nor the factor followed this parameter, the next full solve sets up anew
+      target_set = NAN;
+    }
+    else if( contour!=NULL )
+    {
+      grvy_timer_begin("solve");
+      solveContour(contour,K,D,E,scaleEigenvalue(&scaling,p,1));
+      grvy_timer_end("solve");
+    }
+    else
+    {
+      // A stale factor is kept for as long as the inner solves it preconditions stay cheap, a
+      // failed refinement left it at a shift of its own
+      if( factor!=NULL && (refactor || newton_tried) )
+      {
+        if( !factor->stale || newton_tried || staleFactorExpired(factor) )
+        {
+          factorShifted(factor,TO_PETSC_COMPLEX(target));
+          factor_state = factor->updated ? "updated" : "refactored";
+        }
+        else
+        {
+          factor->reuses++;
+          factor_state = "reused";
+        }
+      }
+      if( factor!=NULL )
+        resetFactorStats(factor);
+      if( inner!=NULL )
+        resetInnerStats(inner);
+      
+      grvy_timer_begin("solve");
+      PEPSolve(pep);
+      grvy_timer_end("solve");
+      if( factor!=NULL && strcmp(factor_state,"reused")==0 && innerSolveFailed(factor) )
+      {
+        // The reused factor could not bring the inner solves to tolerance, renew it and solve again
+        factor->reuses--;
+        factorShifted(factor,TO_PETSC_COMPLEX(target));
+        factor_state = "refactored";
+        resetFactorStats(factor);
+        grvy_timer_begin("solve");
+        PEPSolve(pep);
+        grvy_timer_end("solve");
+      }
+      if( factor!=NULL && relaxedFactorStalled(factor) )
+      {
+        // The corrections do not make up for the relaxed factor here, the exact one takes over
+        // for the rest of the sweep
+        restoreExactFactor(factor,st);
+        factorShifted(factor,TO_PETSC_COMPLEX(target));
+        factor_state = "made exact";
+        resetFactorStats(factor);
+        grvy_timer_begin("solve");
+        PEPSolve(pep);
+        grvy_timer_end("solve");
+      }
+    }
     
     grvy_timer_begin("postprocess");
-    PEPGetConverged(pep,&nConverged);
+    if( rom_solved )
+    {
+      nConverged = rom->nsolved;
+      nIterations = 0;
+    }
+    else if( newton_solved )
+    {
+      nConverged = 1;
+      nIterations = newton->its;
+    }
+    else if( contour!=NULL )
+    {
+      nConverged = contour->nfound;
+      nIterations = 0;
+    }
+    else
+    {
+      PEPGetConverged(pep,&nConverged);
+      PEPGetIterationNumber(pep,&nIterations);
+      total_iterations += nIterations;
+      solved++;
+      if( inner!=NULL )
+      {
+        inner_counts[0] += inner->solves;
+        inner_counts[1] += inner->its;
+      }
+    }
+    if( warm!=NULL )
+      beginEigenvectors(warm,getParameterValue(p));
+    if( tracker!=NULL )
+      beginCandidates(tracker);
+    if( slicer!=NULL )
+      beginSlice(slicer);
     for (ev=0; ev<nConverged; ev++)
     {
-      PEPGetEigenpair( pep, ev, &lambda_solved, NULL, Uout, NULL );
-      logOutput(", %.3f%+.3fj",PetscRealPart(lambda_solved),PetscImaginaryPart(lambda_solved));
+      if( rom_solved )
+        getReducedEigenpair(rom,ev,&lambda_solved,Uout);
+      else if( newton_solved )
+        getNewtonEigenpair(newton,&lambda_solved,Uout);
+      else if( contour!=NULL )
+        getContourEigenpair(contour,ev,&lambda_solved,Uout);
+      else
+        PEPGetEigenpair( pep, ev, &lambda_solved, NULL, Uout, NULL );
+      lambda = unscaleEigenvalue(&scaling,p,TO_DOUBLE_COMPLEX(lambda_solved));
+      if( tracker!=NULL )
+        addCandidate(tracker,lambda,Uout);
+      else if( slicer!=NULL )
+        addSliceEigenvalue(slicer,lambda);
+      else
+        logOutput(", %.3f%+.3fj",creal(lambda),cimag(lambda));
       
       if(ev==0) // Leading eigenvalue/eigenvector (should be closest to target)
       {
-        if( getOptBooleanLUA("update_lambda_tgt", false) )
-        {
-          lambda_tgt = TO_DOUBLE_COMPLEX(lambda_solved);
-        }
-        if( getOptBooleanLUA("update_initspace", false) )
-        {
-          VecCopy(Uout,Uinit);
-          PEPSetInitialSpace(pep,1,&Uinit);
-        }
+        lambda_lead = lambda;
+        if( newton!=NULL )
+          setNewtonMode(newton,Uout);
       }
+      if( warm!=NULL )
+        addEigenvector(warm,Uout);
+      if( rom!=NULL && !rom_solved )
+        addBasisVector(rom,Uout);
       if( getOptBooleanLUA("save_solutions", false) )
       {
         char filename[PETSC_MAX_PATH_LEN];
         char *output_dir = getOptStringLUA("output_dir","./");
-        sprintf(filename,"%s/U_%E_%i.dat",output_dir,creal( getParameterValue(p) ),ev);
+        if( slicer!=NULL )
+          sprintf(filename,"%s/U_%E_%i_%i.dat",output_dir,creal( getParameterValue(p) ),slicer->slice,ev);
+        else
+          sprintf(filename,"%s/U_%E_%i.dat",output_dir,creal( getParameterValue(p) ),ev);
         free(output_dir);
         grvy_check_file_path(filename);
         PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&viewer);
@@ -143,28 +503,172 @@ void qeppsSweeper(void)
         PetscViewerDestroy(&viewer);
       }
     }
+    if( rom!=NULL && !rom_solved )
+      projectBasis(rom);
+    lead = nConverged>0;
+    if( tracker!=NULL )
+    {
+      // The first mode leads instead, as long as it is found
+      matchModes(tracker);
+      for (i=0; i<tracker->modes; i++)
+      {
+        if( tracker->match[i]>=0 )
+          logOutput(", %.3f%+.3fj",creal(tracker->lambda[i]),cimag(tracker->lambda[i]));
+        else
+          logOutput(", nan+nanj");
+      }
+      lead = tracker->match[0]>=0;
+      lambda_lead = tracker->lambda[0];
+    }
+    if( slicer!=NULL )
+    {
+      // Every slice has solved this parameter, the first rank writes their eigenvalues
+      mergeSlices(slicer);
+      for (i=0; i<slicer->nmerged; i++)
+        logOutput(", %.3f%+.3fj",creal(slicer->merged[i]),cimag(slicer->merged[i]));
+    }
+    if( lead )
+    {
+      updatePredictor(predictor,getParameterValue(p),lambda_lead);
+      if( getOptBooleanLUA("update_lambda_tgt", false) )
+      {
+        lambda_tgt = lambda_lead;
+      }
+    }
     logOutput("\n");
+    if( warm!=NULL )
+      logOutput("# solve: %i iterations, %i converged, initial space of %i vectors (%i extrapolated)\n",
+                (int)nIterations,(int)nConverged,warm->ninit,warm->extrapolated);
+    else
+      logOutput("# solve: %i iterations, %i converged\n",(int)nIterations,(int)nConverged);
+    if( inner!=NULL && !rom_solved && !newton_solved && contour==NULL )
+      logOutput("# inner %s: %.1f iterations per solve over %i solves, tolerance relaxed up to %.1E, %i vectors recycled\n",
+                inner->type,meanInnerIterations(inner),inner->solves,inner->rtol_used,inner->nrecycled);
+    if( newton_tried )
+      logOutput("# newton: %i factorizations, relative residual %.1E%s\n",newton->its,newton->residual,
+                newton_solved ? "" : ", full solve");
+    if( contour!=NULL && !rom_solved )
+      logOutput("# contour: %i eigenvalues estimated inside, %i extracted, worst residual %.1E%s\n",contour->count,
+                contour->nfound,contour->worst,contour->saturated ? " (as many as probing vectors, raise contour_columns)" : "");
+    if( rom!=NULL && rom_solved )
+      logOutput("# reduced solve: basis of %i vectors, worst residual estimate %.1E\n",rom->projected,rom->worst);
+    else if( rom!=NULL )
+      logOutput("# full solve: reduced residual estimate %.1E, basis enriched to %i vectors\n",rom->worst,rom->projected);
+    if( slicer!=NULL )
+      logOutput("# slices: %i eigenvalues from %i slices, %i duplicates removed\n",
+                slicer->nmerged,slicer->slices,slicer->total-slicer->nmerged);
+    if( tracker!=NULL )
+    {
+      for (i=0, ev=0; i<tracker->modes; i++)
+        ev += tracker->match[i]>=0;
+      logOutput("# tracked %i of %i modes\n",(int)ev,tracker->modes);
+    }
+    if( predictor->predicted && predictor->checked )
+      logOutput("# predicted %.3f%+.3fj, prediction error %.3E\n",creal(predictor->target),cimag(predictor->target),predictor->error);
+    else if( predictor->predicted )
+      logOutput("# predicted %.3f%+.3fj, leading mode not found\n",creal(predictor->target),cimag(predictor->target));
+    if( factor!=NULL && factor->updated )
+      logOutput("# factor updated: change on %i rows\n",factor->lowrank->rank);
+    if( factor!=NULL && factor->condensed!=NULL && strcmp(factor_state,"refactored")==0 )
+      logOutput("# factor condensed: interior %s, Schur complement of %i rows refactored\n",
+                factor->condensed->refactored ? "refactored" : "reused",factor->condensed->size);
+    if( factor!=NULL && (factor->stale || factor->relaxed || strcmp(factor_state,"made exact")==0) )
+      logOutput("# factor %s: %.1f inner iterations per solve, worst relative residual %.1E\n",
+                factor_state,innerIterations(factor),factor->worst);
     
-    if(nConverged==0)
+    if(nConverged==0 && contour==NULL)
       logError("#! Solver did not converge. Aborting...\n");
     grvy_timer_end("postprocess");
+    if( refiner!=NULL )
+    {
+      for (i=0; i<refiner->modes; i++)
+        solved_values[i] = NAN;
+      if( tracker!=NULL )
+      {
+        for (i=0; i<tracker->modes; i++)
+          if( tracker->match[i]>=0 )
+            solved_values[i] = tracker->lambda[i];
+      }
+      else if( lead )
+        solved_values[0] = lambda_lead;
+      endRefinedParameter(refiner,p,solved_values);
+    }
+    else
+      endParameter(farm,p);
   } // loop parameters
+  if( rom!=NULL && farm->group==0 )
+    saveReducedModel(rom);
+  if( refiner!=NULL )
+    writeRefinedSweep(refiner);
+  else
+    mergeParameterFarm(farm);
+  
+  memcpy(rebuilt[0],Ea->count,sizeof(rebuilt[0]));
+  memcpy(rebuilt[1],Da->count,sizeof(rebuilt[1]));
+  memcpy(rebuilt[2],Ka->count,sizeof(rebuilt[2]));
+  predictions = predictor->errors;
+  prediction_error[0] = predictions>0 ? predictor->error_sum/predictions : 0;
+  prediction_error[1] = predictor->error_max;
+  if( tracker!=NULL )
+    lost_modes = tracker->lost;
+  if( slicer!=NULL )
+    slice_duplicates = slicer->duplicates;
+  if( newton!=NULL )
+  {
+    newton_counts[0] = newton->solved;
+    newton_counts[1] = newton->fallbacks;
+  }
+  if( rom!=NULL )
+  {
+    rom_counts[0] = rom->reduced;
+    rom_counts[1] = rom->full;
+    rom_counts[2] = rom->projected;
+  }
+  if( factor!=NULL )
+  {
+    factored[0] = factor->analyses;
+    factored[1] = factor->factorizations;
+    factored[2] = factor->reuses;
+    if( factor->lowrank!=NULL )
+      lowrank_updates = factor->lowrank->updates;
+    if( factor->condensed!=NULL )
+      condensed_complements = factor->condensed->complements;
+  }
   
   grvy_timer_begin("clean");
   PEPDestroy(&pep);
-  MatDestroy(&E);
-  MatDestroy(&D);
-  MatDestroy(&K);
+  if( factor!=NULL )
+    deleteShiftedFactor(factor);
+  deleteParameterFarm(farm);
+  deletePredictor(predictor);
+  if( refiner!=NULL )
+    deleteParameterRefiner(refiner);
+  if( rom!=NULL )
+    deleteReducedModel(rom);
+  if( contour!=NULL )
+    deleteContourSolver(contour);
+  if( slicer!=NULL )
+    deleteSpectrumSlicer(slicer);
+  if( newton!=NULL )
+    deleteNewtonSolver(newton);
+  if( inner!=NULL )
+    deleteInnerSolver(inner);
+  deleteAssembler(Ea);
+  deleteAssembler(Da);
+  deleteAssembler(Ka);
   deleteMatrix(Ec);
   deleteMatrix(Dc);
   deleteMatrix(Kc);
   VecDestroy(&Uout);
-  VecDestroy(&Uinit);
+  if( warm!=NULL )
+    deleteWarmStart(warm);
+  if( tracker!=NULL )
+    deleteModeTracker(tracker);
   grvy_timer_end("clean");
   
   grvy_timer_finalize();
   
-  if( getOptBooleanLUA("print_timing",false) )
+  if( print_timing )
   {
     logOutput("# ================================================\n");
     logOutput("# ================================================\n");
@@ -172,10 +676,39 @@ void qeppsSweeper(void)
     logOutput("# ------------------------------------------------\n");
     logOutput("#      setup: %10.5E secs\n",grvy_timer_elapsedseconds("setup"));
     logOutput("#   assemble: %10.5E secs\n",grvy_timer_elapsedseconds("assemble"));
+    if( factored[0]>0 )
+    {
+      logOutput("#   analysis: %10.5E secs (%i)\n",grvy_timer_elapsedseconds("analysis"),factored[0]);
+      logOutput("#     factor: %10.5E secs (%i, %i reused)\n",grvy_timer_elapsedseconds("factor"),factored[1],factored[2]);
+    }
+    if( rom_counts[0]+rom_counts[1]>0 )
+      logOutput("#     reduce: %10.5E secs\n",grvy_timer_elapsedseconds("reduce"));
+    if( contoured )
+      logOutput("#    contour: %10.5E secs\n",grvy_timer_elapsedseconds("contour"));
     logOutput("#      solve: %10.5E secs\n",grvy_timer_elapsedseconds("solve"));
     logOutput("#   postproc: %10.5E secs\n",grvy_timer_elapsedseconds("postprocess"));
     logOutput("#      clean: %10.5E secs\n",grvy_timer_elapsedseconds("clean"));
     logOutput("# ------------------------------------------------\n");    
+    logOutput("# rebuilt E (full/delta/skipped): %i/%i/%i\n",rebuilt[0][ASSEMBLY_FULL],rebuilt[0][ASSEMBLY_DELTA],rebuilt[0][ASSEMBLY_SKIPPED]);
+    logOutput("# rebuilt D (full/delta/skipped): %i/%i/%i\n",rebuilt[1][ASSEMBLY_FULL],rebuilt[1][ASSEMBLY_DELTA],rebuilt[1][ASSEMBLY_SKIPPED]);
+    logOutput("# rebuilt K (full/delta/skipped): %i/%i/%i\n",rebuilt[2][ASSEMBLY_FULL],rebuilt[2][ASSEMBLY_DELTA],rebuilt[2][ASSEMBLY_SKIPPED]);
+    logOutput("# solver iterations (total/mean): %i/%.1f\n",total_iterations,solved>0 ? (double)total_iterations/solved : 0.0);
+    if( predictions>0 )
+      logOutput("# prediction error (mean/max): %E/%E over %i predictions\n",prediction_error[0],prediction_error[1],predictions);
+    if( getOptIntLUA("track_modes",0)>0 )
+      logOutput("# lost mode matches: %i\n",lost_modes);
+    if( getSliceCount()>1 )
+      logOutput("# slicing duplicates removed: %i\n",slice_duplicates);
+    if( lowrank_updates>0 )
+      logOutput("# low-rank factor updates: %i\n",lowrank_updates);
+    if( condensed_complements>0 )
+      logOutput("# condensed factor (interior/Schur complement factorizations): %i/%i\n",factored[1],condensed_complements);
+    if( inner_counts[0]>0 )
+      logOutput("# inner iterations (total/mean per solve): %i/%.1f\n",inner_counts[1],(double)inner_counts[1]/inner_counts[0]);
+    if( newton_counts[0]+newton_counts[1]>0 )
+      logOutput("# newton refinements (solved/fell back): %i/%i\n",newton_counts[0],newton_counts[1]);
+    if( rom_counts[0]+rom_counts[1]>0 )
+      logOutput("# reduced model (reduced/full solves): %i/%i, basis of %i vectors\n",rom_counts[0],rom_counts[1],rom_counts[2]);
     logOutput("# assemble  (   count): %i\n",     grvy_timer_stats_count("assemble"));
     logOutput("# assemble  (    mean): %E secs\n",grvy_timer_stats_mean("assemble"));
     logOutput("# assemble  (variance): %E secs\n",grvy_timer_stats_variance("assemble"));
@@ -0,0 +1,160 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Mode tracking: matches the eigenpairs of consecutive parameters by
+// eigenvector overlap and eigenvalue proximity
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <petscmat.h>
+#include "types.h"
+#include "track.h"
+#include "log.h"
+
+// Smallest normalized eigenvector overlap accepted as the same mode
+#define MIN_TRACK_OVERLAP 0.5
+
+// Weight of the relative eigenvalue distance against the overlap
+#define PROXIMITY_WEIGHT 0.5
+
+ModeTracker *createModeTracker(Mat A, int modes, int size)
+{
+  Vec v;
+
+  ModeTracker *t = malloc( sizeof(ModeTracker) );
+  if (t==NULL)
+    logError("#! Allocation of the mode tracker failed\n");
+  t->modes = modes;
+  t->size = size>modes ? size : modes;
+  t->lambda = malloc( sizeof(double complex)*t->modes );
+  t->seen = malloc( sizeof(bool)*t->modes );
+  t->match = malloc( sizeof(int)*t->modes );
+  t->cand_lambda = malloc( sizeof(double complex)*t->size );
+  if (t->lambda==NULL || t->seen==NULL || t->match==NULL || t->cand_lambda==NULL)
+    logError("#! Allocation of the mode tracker failed\n");
+  MatGetVecs(A,&v,NULL);
+  VecDuplicateVecs(v,t->modes,&(t->U));
+  VecDuplicateVecs(v,t->size,&(t->cand));
+  VecDestroy(&v);
+  t->lost = 0;
+  resetModeTracker(t);
+  return t;
+}
+
+void resetModeTracker(ModeTracker *t)
+{
+  int k;
+  for(k=0;k<t->modes;k++)
+  {
+    t->seen[k] = false;
+    t->match[k] = -1;
+  }
+  t->ncand = 0;
+}
+
+void beginCandidates(ModeTracker *t)
+{
+  t->ncand = 0;
+}
+
+void addCandidate(ModeTracker *t, double complex lambda, Vec U)
+{
+  if(t->ncand==t->size)
+    return;
+  t->cand_lambda[t->ncand] = lambda;
+  VecCopy(U,t->cand[t->ncand++]);
+}
+
+void matchModes(ModeTracker *t)
+{
+  int k, j, n=t->ncand, best_k, best_j;
+  PetscScalar dots[n>0 ? n : 1];
+  PetscReal norm_U, norm_c[n>0 ? n : 1];
+  double score[t->modes][n>0 ? n : 1], overlap[t->modes][n>0 ? n : 1], best;
+  bool taken[n>0 ? n : 1];
+
+  for(j=0;j<n;j++)
+  {
+    VecNorm(t->cand[j],NORM_2,&norm_c[j]);
+    taken[j] = false;
+  }
+  for(k=0;k<t->modes;k++)
+  {
+    t->match[k] = -1;
+    if(!t->seen[k] || n==0)
+      continue;
+    VecMDot(t->U[k],n,t->cand,dots);
+    VecNorm(t->U[k],NORM_2,&norm_U);
+    for(j=0;j<n;j++)
+    {
+      overlap[k][j] = PetscAbsScalar(dots[j])/(norm_U*norm_c[j]);
+      score[k][j] = overlap[k][j]
+                  - PROXIMITY_WEIGHT*cabs(t->cand_lambda[j]-t->lambda[k])/(cabs(t->lambda[k])+PETSC_MACHINE_EPSILON);
+    }
+  }
+
+  // Best remaining (mode, candidate) pair first
+  for(;;)
+  {
+    best = -1e300;
+    best_k = best_j = -1;
+    for(k=0;k<t->modes;k++)
+    {
+      if(!t->seen[k] || t->match[k]>=0)
+        continue;
+      for(j=0;j<n;j++)
+        if(!taken[j] && overlap[k][j]>=MIN_TRACK_OVERLAP && score[k][j]>best) {
+          best = score[k][j];
+          best_k = k;
+          best_j = j;
+        }
+    }
+    if(best_k<0)
+      break;
+    t->match[best_k] = best_j;
+    taken[best_j] = true;
+  }
+
+  // Modes without history take what is left, in solver order
+  for(k=0,j=0;k<t->modes;k++)
+  {
+    if(t->seen[k])
+      continue;
+    while(j<n && taken[j]) j++;
+    if(j==n)
+      break;
+    t->match[k] = j;
+    taken[j] = true;
+  }
+
+  for(k=0;k<t->modes;k++)
+  {
+    if(t->match[k]<0) {
+      if(t->seen[k]) t->lost++;
+      continue;
+    }
+    t->lambda[k] = t->cand_lambda[t->match[k]];
+    VecCopy(t->cand[t->match[k]],t->U[k]);
+    t->seen[k] = true;
+  }
+}
+
+void deleteModeTracker(ModeTracker *t)
+{
+  VecDestroyVecs(t->modes,&(t->U));
+  VecDestroyVecs(t->size,&(t->cand));
+  free(t->lambda);
+  free(t->seen);
+  free(t->match);
+  free(t->cand_lambda);
+  free(t);
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Mode tracking: matches the eigenpairs of consecutive parameters by
+// eigenvector overlap and eigenvalue proximity
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_TRACK
+#define QEPPS_TRACK
+
+typedef struct
+{
+  int modes;               // Tracked modes, one output column each
+  Vec *U;                  // Last eigenvector of each mode
+  double complex *lambda;  // Last eigenvalue of each mode
+  bool *seen;              // A vector of the mode is stored
+  int *match;              // Candidate matched to each mode at this parameter, -1 when lost
+  int size;                // Room for candidates
+  Vec *cand;               // Converged pairs of this parameter
+  double complex *cand_lambda;
+  int ncand;
+  int lost;                // Mode matches missed over the sweep
+} ModeTracker;
+
+/*!
+ *  Sets up tracking of modes eigenpairs with vectors compatible with A and room for size
+ *  converged pairs per parameter, allocated once for the whole sweep
+ */
+ModeTracker *createModeTracker(Mat A, int modes, int size);
+
+/*!
+ *  Forgets all modes, the next parameter starts them over
+ */
+void resetModeTracker(ModeTracker *t);
+
+/*!
+ *  Collects the converged pairs of one parameter (in solver order) before matchModes()
+ */
+void beginCandidates(ModeTracker *t);
+void addCandidate(ModeTracker *t, double complex lambda, Vec U);
+
+/*!
+ *  Assigns the candidates to the modes, greedily by eigenvector overlap less a penalty for the
+ *  relative eigenvalue distance. Matches below the overlap threshold are refused and leave the
+ *  mode lost for this parameter. Modes not seen yet take the unassigned candidates in solver
+ *  order. Matched modes store the new eigenpair.
+ */
+void matchModes(ModeTracker *t);
+
+void deleteModeTracker(ModeTracker *t);
+
+#endif
@@ -28,6 +28,7 @@
 typedef struct
 {
     int num;
+    bool symmetric; // Every component is complex symmetric (only checked if symmetric_storage is set)
     Mat matrix[];
 } MatrixComponent;
 
@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Preallocated eigenvector pool used to warm start each solve from the
+// eigenvectors of the previous parameter(s)
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#include <slepcpep.h>
+#include "types.h"
+#include "warmstart.h"
+#include "log.h"
+
+// Smallest normalized overlap for two eigenvectors to be taken as the same mode
+#define MIN_MODE_OVERLAP 0.9
+
+WarmStart *createWarmStart(Mat A, int size, bool extrapolate)
+{
+  Vec v;
+
+  WarmStart *w = malloc( sizeof(WarmStart) );
+  if (w==NULL)
+    logError("#! Allocation of the warm start failed\n");
+  w->size = size>0 ? size : 1;
+  w->extrapolate = extrapolate;
+  MatGetVecs(A,&v,NULL);
+  VecDuplicateVecs(v,w->size,&(w->cur));
+  VecDuplicateVecs(v,w->size,&(w->prev));
+  VecDuplicateVecs(v,w->size,&(w->init));
+  VecDestroy(&v);
+  resetWarmStart(w);
+  return w;
+}
+
+void resetWarmStart(WarmStart *w)
+{
+  w->ncur = w->nprev = 0;
+  w->x_cur = w->x_prev = 0;
+  w->ninit = w->extrapolated = 0;
+}
+
+void beginEigenvectors(WarmStart *w, double complex x)
+{
+  Vec *swap = w->prev;
+
+  w->prev = w->cur;
+  w->cur = swap;
+  w->nprev = w->ncur;
+  w->x_prev = w->x_cur;
+  w->ncur = 0;
+  w->x_cur = x;
+}
+
+void addEigenvector(WarmStart *w, Vec U)
+{
+  if(w->ncur<w->size)
+    VecCopy(U,w->cur[w->ncur++]);
+}
+
+// init = cur + s*(cur - alpha*prev), with prev the previous eigenvector overlapping cur the
+// most and alpha aligning its phase. Returns false (init not set) without such a vector.
+static bool extrapolateEigenvector(WarmStart *w, int i, double complex s, Vec init)
+{
+  int j, best=-1;
+  PetscScalar dots[w->nprev];
+  PetscReal norm_cur, norm_prev, overlap, best_overlap=0;
+  double complex alpha;
+
+  VecMDot(w->cur[i],w->nprev,w->prev,dots);
+  VecNorm(w->cur[i],NORM_2,&norm_cur);
+  for(j=0;j<w->nprev;j++)
+  {
+    VecNorm(w->prev[j],NORM_2,&norm_prev);
+    overlap = PetscAbsScalar(dots[j])/(norm_cur*norm_prev);
+    if(overlap>best_overlap) {
+      best_overlap = overlap;
+      best = j;
+    }
+  }
+  if(best<0 || best_overlap<MIN_MODE_OVERLAP)
+    return false;
+
+  VecNorm(w->prev[best],NORM_2,&norm_prev);
+  alpha = TO_DOUBLE_COMPLEX(dots[best])/PetscAbsScalar(dots[best])*norm_cur/norm_prev;
+  VecCopy(w->cur[i],init);
+  VecAXPBY(init,TO_PETSC_COMPLEX(-s*alpha),TO_PETSC_COMPLEX(1+s),w->prev[best]);
+  return true;
+}
+
+int setWarmStart(WarmStart *w, PEP pep, double complex x)
+{
+  int i;
+  double complex s=0;
+  bool extrapolate = w->extrapolate && w->nprev>0 && w->x_cur!=w->x_prev;
+
+  w->ninit = w->ncur;
+  w->extrapolated = 0;
+  if(w->ncur==0)
+    return 0;
+  if(extrapolate)
+    s = (x-w->x_cur)/(w->x_cur-w->x_prev);
+  for(i=0;i<w->ncur;i++)
+  {
+    if(extrapolate && extrapolateEigenvector(w,i,s,w->init[i]))
+      w->extrapolated++;
+    else
+      VecCopy(w->cur[i],w->init[i]);
+  }
+  PEPSetInitialSpace(pep,w->ninit,w->init);
+  return w->ninit;
+}
+
+void deleteWarmStart(WarmStart *w)
+{
+  VecDestroyVecs(w->size,&(w->cur));
+  VecDestroyVecs(w->size,&(w->prev));
+  VecDestroyVecs(w->size,&(w->init));
+  free(w);
+}
@@ -0,0 +1,59 @@
+//-----------------------------------------------------------------------bl-
+//--------------------------------------------------------------------------
+// 
+// QEPPS: Quadratic eigenvalue problem parameter sweeper
+//
+// Copyright (C) 2014 Lab for Active Nano Devices, UT ECE 
+// Developed by Ian Williamson 
+// Supervised by Dr. Zheng Wang 
+//
+//-----------------------------------------------------------------------el-
+// 
+// Preallocated eigenvector pool used to warm start each solve from the
+// eigenvectors of the previous parameter(s)
+// 
+//--------------------------------------------------------------------------
+//--------------------------------------------------------------------------
+
+#ifndef QEPPS_WARMSTART
+#define QEPPS_WARMSTART
+
+typedef struct
+{
+  int size;                // Vectors per set
+  bool extrapolate;        // Extrapolate linearly from the last two parameters
+  Vec *cur, *prev;         // Eigenvectors of the last and the one before
+  int ncur, nprev;
+  double complex x_cur, x_prev;
+  Vec *init;               // Initial space handed to the solver
+  int ninit;               // Vectors in the last initial space
+  int extrapolated;        // Of which extrapolated
+} WarmStart;
+
+/*!
+ *  Allocates the three sets of size vectors compatible with A once for the whole sweep
+ */
+WarmStart *createWarmStart(Mat A, int size, bool extrapolate);
+
+/*!
+ *  Forgets the stored eigenvectors
+ */
+void resetWarmStart(WarmStart *w);
+
+/*!
+ *  Starts a new set of eigenvectors for parameter value x, the current set becomes the
+ *  previous one. addEigenvector() then copies up to size eigenvectors into it.
+ */
+void beginEigenvectors(WarmStart *w, double complex x);
+void addEigenvector(WarmStart *w, Vec U);
+
+/*!
+ *  Hands the stored eigenvectors to pep as its initial space for parameter value x. With
+ *  extrapolation, each vector is matched to the previous set by overlap, aligned in phase,
+ *  and extrapolated linearly in the parameter. Returns the number of vectors.
+ */
+int setWarmStart(WarmStart *w, PEP pep, double complex x);
+
+void deleteWarmStart(WarmStart *w);
+
+#endif
@@ -15,9 +15,56 @@ options["nev"] = 6 --This will override the -pep_nev argument for the number of
 options["output_dir"] = "./ppwg" --Location to save solution vectors
 options["output_log"] = options["output_dir"].."/output_"..JOB_ID..".txt" --File in which qepps (text) output will be saved
 options["update_lambda_tgt"] = false --Update target eigenvalue from eigenvalue solved at previous parameter value
-options["update_initspace"] = false --Update solver space from solution vector of previous parameter value
+options["update_initspace"] = false --Start the solver from all converged eigenvectors (up to nev) of the previous parameter value
+options["extrapolate_initspace"] = false --With update_initspace, extrapolate each eigenvector linearly from the last two parameter values
+options["track_modes"] = 0 --Track this many modes by eigenvector overlap and eigenvalue proximity, one output column per mode (nan where lost); overrides nev
+options["refine_tolerance"] = 0 --If >0, refine adaptively between the parameters above: insert midpoints until linear interpolation of the tracked eigenvalues is within this relative error (output stays sorted)
+options["refine_max_points"] = 200 --With refine_tolerance, most parameters solved in total
+options["rom_tolerance"] = 0 --If >0, solve a reduced model (components projected onto eigenvectors of earlier full solves) and fall back to a full solve, enriching the basis, when an eigenpair residual estimate exceeds this
+options["rom_max_basis"] = 100 --With rom_tolerance, most basis vectors of the reduced model
+options["rom_file"] = "" --With rom_tolerance, load the reduced model from this file if it exists and save it there at the end
+options["contour_radius"] = 0 --If >0, find all eigenvalues inside the circle of this radius around contour_center by a contour integral instead of shift-and-invert (nev and lambda_tgt are then unused)
+options["contour_center"] = 0 --Centre of the contour circle
+options["contour_lower"] = 0 --With contour_upper (and no contour_radius), lower left corner of a rectangle to find all eigenvalues in
+options["contour_upper"] = 0 --Upper right corner of the contour rectangle
+options["contour_nodes"] = 32 --Quadrature nodes on the contour, one factorization each
+options["contour_columns"] = 16 --Probing vectors, must exceed the number of eigenvalues inside the region
+options["contour_groups"] = 1 --Split the ranks into this many subcommunicators that factor different quadrature nodes concurrently
+options["contour_tolerance"] = 1E-6 --Relative residual an eigenpair from the contour integral is accepted with
+options["slices"] = 1 --If >1 (and lambda_tgt is a single value), slice the spectrum into this many targets spread along slice_lower to slice_upper, each solved by its own rank group for every parameter with nev eigenvalues; lambda_tgt may instead be a list of targets, e.g. {1.2, 1.4, 1.6}
+options["slice_lower"] = 0 --Start of the segment the slice targets are spread along
+options["slice_upper"] = 0 --End of the segment the slice targets are spread along
+options["slice_tolerance"] = 1E-6 --Relative distance within which eigenvalues found by different slices are merged as one
+options["newton_max_its"] = 0 --If >0 (with nev = 1), refine the eigenpair of the previous parameter by Rayleigh quotient iteration with up to this many factorizations, and only run the full solve when it does not converge
+options["newton_tolerance"] = 1E-8 --Relative residual the refined eigenpair is accepted with
 options["save_solutions"] = false --Save the solution vector for each parameter value
 options["print_timing"] = true --At conclusion of parameter sweep, print timing
+options["benchmark_assembly"] = 0 --If >0, time this many fused assemblies of E, D, and K against the equivalent MatAXPY chain at setup
+options["matrix_free"] = false --Apply E, D, and K matrix-free from their components (requires an iterative -st_ksp_type and a -st_pc_type other than lu)
+options["stacked_components"] = false --Store the components of each matrix interleaved on one shared nonzero pattern (saves index memory when the patterns coincide)
+options["real_components"] = false --Keep components without an imaginary part as real values and release their matricies (halves their memory)
+options["symmetric_storage"] = false --If every component is complex symmetric, store only upper triangles (SBAIJ) and factor with cholesky (LDL^T)
+options["block_storage"] = false --Store components in BAIJ format when all of them share a block structure (assembly then adds whole blocks of values at a time)
+options["block_size"] = 0 --Block size for block_storage and the inner_pc operators, 0 detects it (up to 8)
+options["separable_rescaling"] = false --Rescale the eigenvalue (lambda = mu*x^t) when that makes more of E, D, and K independent of the parameter (with t != 0 the scaled target changes every parameter, so nothing is reused at a fixed shift)
+options["reuse_analysis"] = false --With a direct -st_pc_type (lu/cholesky), order and symbolically factor the shifted matrix once and only refactor numerically per parameter
+options["stale_factor"] = false --With reuse_analysis, keep the factor of an earlier parameter as a gmres preconditioner instead of refactoring each parameter
+options["refactor_iterations"] = 10 --With stale_factor, refactor once the inner solves take more than this many iterations each (or miss their tolerance)
+options["relaxed_factor"] = false --With reuse_analysis and mumps, factor without threshold pivoting but with static pivoting (less fill, no delayed pivots) and correct the solves by gmres; falls back to the exact factor once the corrections take more than refactor_iterations
+options["lowrank_max_rank"] = 0 --With reuse_analysis, if >0 and the shift is unchanged (no update_lambda_tgt or predictor), keep the factor when the shifted matrix only changed on up to this many rows (e.g. a sheet conductivity) and apply the change by a Woodbury update
+options["condense_max_interface"] = 0 --With reuse_analysis and default storage, if >0 eliminate the rows no parameter-dependent component touches once per shift and factor only the dense Schur complement of the others per parameter, when they are at most this many (it takes this many solves and vectors per shift)
+options["inner_solver"] = "" --If set (gmres or bcgs), solve the shifted systems iteratively instead of by the -st_ksp_type/-st_pc_type of the command line, for meshes whose LU factors do not fit in memory (a memory estimate against LU is printed)
+options["inner_pc"] = "asm" --With inner_solver, preconditioner: asm (incomplete factorization per subdomain), gamg (algebraic multigrid), or jacobi; asm and gamg give the operators the block size of a node (see block_size) so that gamg aggregates keep its fields together, -st_sub_pc_type and -st_sub_pc_factor_levels on the command line take precedence
+options["inner_asm_overlap"] = 1 --With inner_pc asm, overlap of the subdomains
+options["inner_ilu_levels"] = 0 --With inner_pc asm, fill levels of the subdomain incomplete factorizations
+options["inner_restart"] = 30 --With inner_solver gmres, restart length
+options["inner_rtol"] = 0 --Inner relative tolerance while the eigenpairs are far from converged, 0 for 1E-2 of the eigensolver tolerance
+options["inner_rtol_max"] = 1E-2 --Loosest inner relative tolerance, reached as the outer residual goes down (inner_rtol divided by the residual estimate)
+options["inner_recycle"] = 0 --With inner_solver, deflate the Krylov iteration by a recycle space of this many of the latest inner solutions, kept across solves and parameters
+options["ranks_per_group"] = 0 --If >0, split the MPI ranks into groups of this size that solve different parameters concurrently (output is merged in order at the end)
+options["parameter_chunk"] = 0 --Contiguous parameters a group takes at a time, 0 picks about a quarter of an even share
+options["predictor"] = "none" --Target each parameter at the leading eigenvalue extrapolated from the last ones: none, linear, quadratic, or rational (overrides update_lambda_tgt)
+options["predictor_points"] = 3 --Number of previous parameters the predictor fits
 
 -- Scaling functions
 function p0(x)   return x^0   end
@@ -0,0 +1,59 @@
+-- Regression cases: runs a test problem with the options of one sweep mode on top, chosen by
+-- the QEPPS_MODE environment variable (see run_regress.sh, which compares every mode against
+-- the default path of its problem and checks that the mode did run)
+
+MODE = os.getenv("QEPPS_MODE")
+if (MODE == nil or MODE == '') then   MODE = "default"   end
+
+-- Problem of each mode and its options, applied over those of the problem. "ppwg" is the
+-- parallel plate waveguide, "sheet" the graphene model of gr3d.lua at a fixed frequency,
+-- where only the sheet conductivity (a component on few rows) changes with the parameter.
+modes = {}
+modes["default"] = {problem="ppwg", options={}}
+modes["fused"] = {problem="ppwg", options={benchmark_assembly=3}}
+modes["delta"] = {problem="ppwg", options={}} --K is split below so that every assembly of it is full
+modes["farm"] = {problem="ppwg", options={ranks_per_group=2}}
+modes["tracking"] = {problem="ppwg", options={track_modes=2}}
+modes["refinement"] = {problem="ppwg", options={refine_tolerance=1E-3, refine_max_points=60}}
+modes["rom"] = {problem="ppwg", options={rom_tolerance=1E-8}}
+modes["contour"] = {problem="ppwg", options={contour_center=1.4, contour_radius=0.1}}
+modes["slicing"] = {problem="ppwg", options={lambda_tgt={1.4, 1.5}}}
+modes["newton"] = {problem="ppwg", options={nev=1, newton_max_its=5, reuse_analysis=true}}
+modes["inner"] = {problem="ppwg", options={inner_solver="gmres", inner_pc="asm", inner_ilu_levels=1}}
+modes["symmetric"] = {problem="ppwg", options={symmetric_storage=true}}
+modes["block"] = {problem="ppwg", options={block_storage=true}}
+modes["separable"] = {problem="ppwg", options={separable_rescaling=true}}
+modes["stale"] = {problem="ppwg", options={reuse_analysis=true, stale_factor=true}}
+modes["relaxed"] = {problem="ppwg", options={reuse_analysis=true, relaxed_factor=true}}
+modes["predictor"] = {problem="ppwg", options={predictor="linear"}}
+modes["initspace"] = {problem="ppwg", options={update_initspace=true}}
+modes["sheet"] = {problem="sheet", options={}}
+modes["lowrank"] = {problem="sheet", options={reuse_analysis=true, lowrank_max_rank=2000}}
+modes["condense"] = {problem="sheet", options={reuse_analysis=true, condense_max_interface=2000}}
+
+if (modes[MODE] == nil) then   error("Unknown QEPPS_MODE '"..MODE.."'")   end
+
+if (modes[MODE].problem == "ppwg") then
+  dofile("ppwg.lua")
+else
+  dofile("gr3d.lua")
+  -- E, D, and the bulk of K are taken at the first frequency, a fixed target keeps the shift
+  -- (and so the factor) the same across the sweep
+  x0 = parameters[1]
+  function frozen(f)   return function(x)   return f(x0)   end   end
+  matricies.E.func = {frozen(p2)}
+  matricies.D.func = {frozen(p1)}
+  matricies.K.func = {frozen(p0),frozen(p2),pS}
+  options["update_lambda_tgt"] = false
+end
+
+for name, value in pairs(modes[MODE].options) do   options[name] = value   end
+options["output_log"] = "./regress_"..MODE.."_"..JOB_ID..".txt"
+
+-- The default path changes one of the two components of K per parameter and updates it by
+-- deltas, here K2 is given as two halves that both change so that K is assembled in full
+function p2_half(x)   return 0.5*x^2   end
+if (MODE == "delta") then
+  matricies.K.data = {options["output_dir"].."/K0.dat",options["output_dir"].."/K2.dat",options["output_dir"].."/K2.dat"}
+  matricies.K.func = {p0,p2_half,p2_half}
+end
@@ -0,0 +1,161 @@
+#!/bin/bash
+# This script runs the test problems once on their default path and once for
+# each sweep mode of regress.lua. It compares the eigenvalue lines of every
+# mode against those of the default path of its problem, and checks the log
+# for a line showing that the mode did run (a mode that silently falls back
+# to the default path fails).
+#
+# Usage: run_regress.sh [mode ...]   (all modes when none are given)
+#
+# The launcher defaults to ibrun as in run_ppwg.sh, set MPIEXEC (e.g. to
+# "mpirun -n 8") to run elsewhere. Eigenvalues are printed with 3 decimals,
+# TOLERANCE is the largest difference accepted in their real and imaginary
+# parts. The script changes to its own directory, as the lua scripts point
+# to data files at ./ppwg and ./gr3d.
+
+# Resolve the directory of this script
+# taken from http://stackoverflow.com/questions/59895/can-a-bash-script-tell-what-directory-its-stored-in
+SOURCE="${BASH_SOURCE[0]}"
+while [ -h "$SOURCE" ]; do
+  DIR="$( cd -P "$( dirname "$SOURCE" )" && pwd )"
+  SOURCE="$(readlink "$SOURCE")"
+  [[ $SOURCE != /* ]] && SOURCE="$DIR/$SOURCE"
+done
+DIR="$( cd -P "$( dirname "$SOURCE" )" && pwd )"
+
+QEPPS_EXE=$DIR/../qepps
+CONFIG_LUA=$DIR/regress.lua
+NUMPROC=8
+MPIEXEC=${MPIEXEC:-"ibrun -n $NUMPROC -o 0"}
+TOLERANCE=${TOLERANCE:-2E-3}
+JOB_ID=${SLURM_JOB_ID:-0}
+
+# How the eigenvalues of each mode are compared against the default path:
+#   same     - the same eigenvalues at every parameter of the default path
+#   subset   - each eigenvalue (nan aside) is one of the default path
+#   superset - each eigenvalue of the default path is among them
+#   lead     - the first eigenvalue (nearest the target) is one of the default
+#              path, for modes that move the target
+#   region   - the default eigenvalues inside the contour circle are found, and
+#              nothing outside it (center and radius as in regress.lua)
+declare -A COMPARE=(
+  [fused]=same [delta]=same [farm]=same [tracking]=subset [refinement]=same
+  [rom]=same [contour]="region 1.4 0.1" [slicing]=superset [newton]=subset
+  [inner]=same [symmetric]=same [block]=same [separable]=lead [stale]=same
+  [relaxed]=same [predictor]=lead [initspace]=same [lowrank]=same [condense]=same
+)
+# Default path each mode is compared against (default unless given)
+declare -A REFERENCE=( [lowrank]=sheet [condense]=sheet )
+# Log line (extended regular expression) showing that the mode did run
+declare -A EXPECT=(
+  [fused]="^# assembly benchmark"
+  [delta]="^# rebuilt K \(full/delta/skipped\): [0-9]+/0/"
+  [farm]="^# parameter farm: [2-9] groups"
+  [tracking]="^# tracked [0-9]+ of 2 modes"
+  [refinement]="^# adaptive refinement: [0-9]+ parameters solved"
+  [rom]="^# reduced solve:"
+  [contour]="^# contour: [0-9]+ eigenvalues estimated"
+  [slicing]="^# slices:"
+  [newton]="^# newton refinements \(solved/fell back\): [1-9]"
+  [inner]="^# inner gmres:"
+  [symmetric]="^# sbaij storage of"
+  [block]="^# baij storage of"
+  [separable]="^# separable form: lambda"
+  [stale]="^# factor reused:"
+  [relaxed]="^# relaxed factor: static pivoting"
+  [predictor]="^# predicted .*prediction error"
+  [initspace]="initial space of [1-9]"
+  [lowrank]="^# factor updated:"
+  [condense]="^# factor condensed:"
+)
+MODES="fused delta farm tracking refinement rom contour slicing newton inner symmetric block separable stale relaxed predictor initspace lowrank condense"
+if [ $# -gt 0 ]; then MODES="$@"; fi
+
+cd $DIR
+
+run_mode() {
+  QEPPS_MODE=$1 $MPIEXEC $QEPPS_EXE -lua $CONFIG_LUA -st_pc_factor_mat_solver_package mumps -st_ksp_type preonly -st_pc_type lu > /dev/null
+}
+
+# Compares the eigenvalue lines of two output files, parameters missing from
+# the first one (e.g. inserted by refinement) are skipped
+compare() {
+  awk -F', ' -v how="$1" -v center="$2" -v radius="$3" -v tol=$TOLERANCE '
+    function parse(s, z,   k, i) {
+      sub(/j$/,"",s)
+      k = 0
+      for(i=2;i<=length(s);i++)
+        if(substr(s,i,1)=="+" || substr(s,i,1)=="-") k = i
+      z["re"] = substr(s,1,k-1)+0; z["im"] = substr(s,k)+0
+      return s !~ /nan/
+    }
+    function near(a, b) {
+      return (a["re"]-b["re"])^2 <= tol^2 && (a["im"]-b["im"])^2 <= tol^2
+    }
+    # Is every eigenvalue of line x (inside the circle when given) one of line y
+    function contained(x, nx, y, ny, r,   i, j, a, b, found) {
+      for(i=2;i<=nx;i++) {
+        if(!parse(x[i],a)) continue
+        if(r>0 && (a["re"]-center)^2+a["im"]^2 >= (r-tol)^2) continue
+        found = 0
+        for(j=2;j<=ny && !found;j++)
+          if(parse(y[j],b) && near(a,b)) found = 1
+        if(!found) return 0
+      }
+      return 1
+    }
+    /^#/ || NF==0 { next }
+    NR==FNR { ref[$1] = $0; next }
+    ($1 in ref) {
+      checked[$1] = 1
+      nx = split($0,x,", "); ny = split(ref[$1],y,", ")
+      ok = 1
+      if(how=="same")     ok = nx==ny && contained(x,nx,y,ny,0) && contained(y,ny,x,nx,0)
+      if(how=="subset")   ok = contained(x,nx,y,ny,0)
+      if(how=="superset") ok = contained(y,ny,x,nx,0)
+      if(how=="lead")     ok = contained(x,2,y,ny,0)
+      if(how=="region") {
+        ok = contained(y,ny,x,nx,radius)
+        for(i=2;i<=nx;i++)
+          if(parse(x[i],a) && (a["re"]-center)^2+a["im"]^2 > (radius+tol)^2) ok = 0
+      }
+      if(!ok) { print "#   " $1 ": " $0 " against " ref[$1]; failed++ }
+    }
+    END {
+      for(p in ref) if(!(p in checked)) { print "#   " p ": missing"; failed++ }
+      exit failed>0
+    }' $4 $5
+}
+
+# Each default path is run once, when the first mode needs it
+declare -A REFERENCE_RUN
+run_reference() {
+  if [ -z "${REFERENCE_RUN[$1]}" ]; then
+    run_mode $1 && REFERENCE_RUN[$1]=ok || REFERENCE_RUN[$1]=failed
+  fi
+  [ "${REFERENCE_RUN[$1]}" == ok ]
+}
+
+FAILED=0
+for MODE in $MODES; do
+  if [ -z "${COMPARE[$MODE]}" ]; then echo "# $MODE: unknown mode"; FAILED=$((FAILED+1)); continue; fi
+  REF=${REFERENCE[$MODE]:-default}
+  OUTPUT=regress_${MODE}_${JOB_ID}.txt
+  set -- ${COMPARE[$MODE]}
+  if ! run_reference $REF; then
+    echo "# $MODE: FAIL (default path '$REF' failed)"
+  elif ! run_mode $MODE; then
+    echo "# $MODE: FAIL (run failed)"
+  elif ! grep -Eq "${EXPECT[$MODE]}" $OUTPUT; then
+    echo "# $MODE: FAIL (no line matching '${EXPECT[$MODE]}', the mode did not run)"
+  elif ! compare "$1" "$2" "$3" regress_${REF}_${JOB_ID}.txt $OUTPUT; then
+    echo "# $MODE: FAIL (eigenvalues differ from '$REF')"
+  else
+    echo "# $MODE: PASS"
+    continue
+  fi
+  FAILED=$((FAILED+1))
+done
+
+echo "# $FAILED mode(s) failed"
+exit $FAILED